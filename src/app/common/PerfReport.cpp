@@ -0,0 +1,170 @@
+/*!
+  @file   PerfReport.cpp
+  @author David Hirvonen
+  @brief  Throughput, latency and memory summary with baseline regression checks.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "PerfReport.h"
+
+#include <nlohmann/json.hpp> // nlohman-json
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+// clang-format off
+#if defined(__unix__) || defined(__APPLE__)
+#  define DRISHTI_SDK_TEST_HAVE_RUSAGE 1
+#  include <sys/resource.h>
+#endif
+// clang-format on
+
+void PerfReport::addOptions(cxxopts::Options& options, Settings& settings)
+{
+    // clang-format off
+    options.add_options()
+        ("report", "Write a performance summary (JSON)", cxxopts::value<std::string>(settings.report))
+        ("baseline", "Fail if the performance regressed w.r.t. this baseline (JSON)", cxxopts::value<std::string>(settings.baseline))
+        ("tolerance", "Allowed relative regression (i.e., 0.1 == 10%)", cxxopts::value<double>(settings.tolerance))
+        ("update-baseline", "Overwrite the baseline with this run", cxxopts::value<bool>(settings.update))
+    ;
+    // clang-format on
+}
+
+double PerfReport::getPercentile(double p) const
+{
+    if (samples.empty())
+    {
+        return 0.0;
+    }
+
+    // Nearest rank:
+    std::vector<double> sorted = samples;
+    const auto rank = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+    const auto index = std::min(std::max(rank, std::size_t(1)), sorted.size()) - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+double PerfReport::getPeakMemory()
+{
+#if defined(DRISHTI_SDK_TEST_HAVE_RUSAGE)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#if defined(__APPLE__)
+        return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0); // bytes
+#else
+        return static_cast<double>(usage.ru_maxrss) / 1024.0; // kilobytes
+#endif
+    }
+#endif
+    return 0.0;
+}
+
+static nlohmann::json toJson(const PerfReport& report, std::size_t count, double elapsed)
+{
+    // clang-format off
+    return nlohmann::json
+    {
+        {"samples", count},
+        {"fps", (elapsed > 0.0) ? (count / elapsed) : 0.0},
+        {"latency_p50_ms", report.getPercentile(0.50) * 1e3},
+        {"latency_p90_ms", report.getPercentile(0.90) * 1e3},
+        {"latency_p99_ms", report.getPercentile(0.99) * 1e3},
+        {"peak_rss_mb", PerfReport::getPeakMemory()}
+    };
+    // clang-format on
+}
+
+bool PerfReport::write(const std::string& filename) const
+{
+    std::ofstream ofs(filename);
+    if (ofs)
+    {
+        ofs << std::setw(4) << toJson(*this, samples.size(), elapsed) << std::endl;
+    }
+    return ofs.good();
+}
+
+bool PerfReport::compare(const std::string& baseline, double tolerance, spdlog::logger& logger) const
+{
+    std::ifstream ifs(baseline);
+    if (!ifs)
+    {
+        logger.error("Failed to open baseline {}", baseline);
+        return false;
+    }
+
+    nlohmann::json expected;
+    ifs >> expected;
+
+    // true: higher is better
+    const std::map<std::string, bool> metrics = {
+        { "fps", true },
+        { "latency_p50_ms", false },
+        { "latency_p90_ms", false },
+        { "latency_p99_ms", false },
+        { "peak_rss_mb", false }
+    };
+
+    const auto measured = toJson(*this, samples.size(), elapsed);
+
+    bool good = true;
+    for (const auto& metric : metrics)
+    {
+        if (!expected.count(metric.first))
+        {
+            continue;
+        }
+
+        const double value = measured.at(metric.first).get<double>();
+        const double reference = expected.at(metric.first).get<double>();
+        const double limit = metric.second ? (reference * (1.0 - tolerance)) : (reference * (1.0 + tolerance));
+        const bool regressed = metric.second ? (value < limit) : (value > limit);
+        if (regressed)
+        {
+            logger.error("Regression: {} = {} (baseline {}, limit {})", metric.first, value, reference, limit);
+            good = false;
+        }
+        else
+        {
+            logger.info("{} = {} (baseline {}, limit {})", metric.first, value, reference, limit);
+        }
+    }
+    return good;
+}
+
+int PerfReport::finish(const Settings& settings, spdlog::logger& logger) const
+{
+    if (!settings.report.empty() && !write(settings.report))
+    {
+        logger.error("Failed to write report {}", settings.report);
+        return 1;
+    }
+
+    if (!settings.baseline.empty())
+    {
+        if (settings.update)
+        {
+            if (!write(settings.baseline))
+            {
+                logger.error("Failed to write baseline {}", settings.baseline);
+                return 1;
+            }
+            logger.info("Updated baseline {}", settings.baseline);
+        }
+        else if (!compare(settings.baseline, settings.tolerance, logger))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*!
+  @file   PerfReport.h
+  @author David Hirvonen
+  @brief  Throughput, latency and memory summary with baseline regression checks.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#ifndef __PerfReport_h__
+#define __PerfReport_h__
+
+#include <cxxopts.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include <string>
+#include <vector>
+
+// A headless run records one latency sample per unit of work (i.e., a frame)
+// and the total elapsed time.  The summary is written as a flat JSON object
+// and compared metric by metric against a baseline kept in the repository:
+//
+//   fps                        : higher is better
+//   latency_p{50,90,99}_ms     : lower is better
+//   peak_rss_mb                : lower is better
+//
+// Metrics that are missing from the baseline are not checked.
+class PerfReport
+{
+public:
+    struct Settings
+    {
+        std::string report;   // write the summary here (optional)
+        std::string baseline; // compare against this baseline (optional)
+        double tolerance = 0.1;
+        bool update = false; // overwrite the baseline with this run
+    };
+
+    static void addOptions(cxxopts::Options& options, Settings& settings);
+
+    void add(double seconds) { samples.push_back(seconds); }
+    void setElapsed(double seconds) { elapsed = seconds; }
+
+    double getPercentile(double p) const; // seconds
+    static double getPeakMemory();        // MB (resident set)
+
+    bool write(const std::string& filename) const;
+
+    // Return false if any metric regressed by more than the tolerance:
+    bool compare(const std::string& baseline, double tolerance, spdlog::logger& logger) const;
+
+    // Apply the settings, returns the process exit code:
+    int finish(const Settings& settings, spdlog::logger& logger) const;
+
+protected:
+    std::vector<double> samples;
+    double elapsed = 0.0;
+};
+
+#endif // __PerfReport_h__
@@ -0,0 +1,126 @@
+/*!
+  @file   EyeSegment.cpp
+  @author David Hirvonen
+  @brief  Fit an eye model to a single eye image and render its mask.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "EyeSegment.h"
+
+#include <drishti/EyeIO.hpp>
+#include <drishti/drishti_cv.hpp>
+
+#include <opencv2/imgproc.hpp>
+
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+drishti::sdk::Eye scale(const drishti::sdk::Eye& eye, float scale)
+{
+    return ::scale(eye, scale, scale);
+}
+
+drishti::sdk::Eye scale(const drishti::sdk::Eye& eye, float sx, float sy)
+{
+    using drishti::sdk::cvToDrishti;
+    using drishti::sdk::drishtiToCv;
+
+    // Scale the ellipse axes as vectors, the result is exact for a uniform
+    // scale (or an axis aligned ellipse) and close for sx ~= sy:
+    const auto scaleEllipse = [sx, sy](cv::RotatedRect ellipse) {
+        const float theta = ellipse.angle * static_cast<float>(CV_PI / 180.0);
+        const cv::Point2f u(std::cos(theta) * sx, std::sin(theta) * sy);  // width axis
+        const cv::Point2f v(-std::sin(theta) * sx, std::cos(theta) * sy); // height axis
+        ellipse.center = { ellipse.center.x * sx, ellipse.center.y * sy };
+        ellipse.size.width *= static_cast<float>(cv::norm(u));
+        ellipse.size.height *= static_cast<float>(cv::norm(v));
+        ellipse.angle = std::atan2(u.y, u.x) * static_cast<float>(180.0 / CV_PI);
+        return ellipse;
+    };
+    const auto scalePoints = [sx, sy](std::vector<cv::Point2f> points) {
+        for (auto& p : points)
+        {
+            p = { p.x * sx, p.y * sy };
+        }
+        return points;
+    };
+    const auto scalePoint = [sx, sy](const drishti::sdk::Vec2f& p) {
+        return drishti::sdk::Vec2f(p[0] * sx, p[1] * sy);
+    };
+
+    drishti::sdk::Eye result(eye);
+    result.setIris(cvToDrishti(scaleEllipse(drishtiToCv(eye.getIris()))));
+    result.setPupil(cvToDrishti(scaleEllipse(drishtiToCv(eye.getPupil()))));
+    result.setEyelids(cvToDrishti(scalePoints(drishtiToCv(eye.getEyelids()))));
+    result.setCrease(cvToDrishti(scalePoints(drishtiToCv(eye.getCrease()))));
+    result.setCorners(scalePoint(eye.getInnerCorner()), scalePoint(eye.getOuterCorner()));
+    return result;
+}
+
+bool segment(drishti::sdk::EyeSegmenter& segmenter, const cv::Mat& image, bool isRight, drishti::sdk::Eye& eye, cv::Mat1b& mask, int width)
+{
+    cv::Mat3b bgr;
+    switch (image.channels())
+    {
+        case 1:
+            cv::cvtColor(image, bgr, cv::COLOR_GRAY2BGR);
+            break;
+        case 3:
+            bgr = image;
+            break;
+        case 4:
+            cv::cvtColor(image, bgr, cv::COLOR_BGRA2BGR);
+            break;
+        default:
+            return false;
+    }
+
+    if (bgr.empty())
+    {
+        return false;
+    }
+
+    // Segment at the working resolution:
+    cv::Mat3b input = bgr;
+    if ((width > 0) && (bgr.cols > width))
+    {
+        const float factor = static_cast<float>(bgr.cols) / static_cast<float>(width);
+        const cv::Size size(width, std::max(cvRound(bgr.rows / factor), 1));
+        cv::resize(bgr, input, size, 0, 0, cv::INTER_AREA);
+    }
+
+    if (!input.isContinuous())
+    {
+        input = input.clone(); // i.e., a crop
+    }
+
+    auto image_ = drishti::sdk::cvToDrishti<cv::Vec3b, drishti::sdk::Vec3b>(input);
+    segmenter(image_, eye, isRight);
+
+    // The rows are rounded separately, so map each axis back with its own factor:
+    if (input.size() != bgr.size())
+    {
+        const float sx = static_cast<float>(bgr.cols) / static_cast<float>(input.cols);
+        const float sy = static_cast<float>(bgr.rows) / static_cast<float>(input.rows);
+        eye = scale(eye, sx, sy);
+    }
+
+    mask.create(bgr.size());
+    mask.setTo(0);
+    auto mask_ = drishti::sdk::cvToDrishti<uint8_t, uint8_t>(mask);
+
+    const int maskKind = static_cast<int>(drishti::sdk::kScleraRegion) | static_cast<int>(drishti::sdk::kIrisRegion);
+    drishti::sdk::createMask(mask_, eye, maskKind);
+    return true;
+}
+
+std::string toJson(const drishti::sdk::Eye& eye)
+{
+    std::stringstream ss;
+    ss << drishti::sdk::EyeOStream(eye, drishti::sdk::EyeOStream::JSON);
+    return ss.str();
+}
@@ -0,0 +1,34 @@
+/*!
+  @file   EyeSegment.h
+  @author David Hirvonen
+  @brief  Fit an eye model to a single eye image and render its mask.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#ifndef __EyeSegment_h__
+#define __EyeSegment_h__
+
+#include <drishti/EyeSegmenter.hpp>
+
+#include <opencv2/core.hpp>
+
+#include <string>
+
+// Fit the eye model to a BGR, BGRA or grayscale image and render the sclera + iris
+// mask (image resolution), returns false if the image can't be segmented.  With
+// width > 0 wider images are segmented at that width (area filter), the eye model
+// is mapped back to image coordinates and the mask is still rendered at the image
+// resolution:
+bool segment(drishti::sdk::EyeSegmenter& segmenter, const cv::Mat& image, bool isRight, drishti::sdk::Eye& eye, cv::Mat1b& mask, int width = 0);
+
+// Scale the eye model geometry (i.e., to map it between image resolutions):
+drishti::sdk::Eye scale(const drishti::sdk::Eye& eye, float scale);
+drishti::sdk::Eye scale(const drishti::sdk::Eye& eye, float sx, float sy);
+
+// Eye model parameters in the SDK JSON format:
+std::string toJson(const drishti::sdk::Eye& eye);
+
+#endif // __EyeSegment_h__
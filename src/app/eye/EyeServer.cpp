@@ -0,0 +1,752 @@
+/*!
+  @file   EyeServer.cpp
+  @author David Hirvonen
+  @brief  Persistent eye segmentation server (stdin/stdout or Unix domain socket).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "EyeServer.h"
+#include "EyeSegment.h"
+
+#include <drishti/EyeSegmenter.hpp>
+
+#include <opencv2/highgui.hpp>
+
+#include <nlohmann/json.hpp> // nlohman-json
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// clang-format off
+#if defined(__unix__) || defined(__APPLE__)
+#  define DRISHTI_SDK_TEST_HAVE_UNIX_SOCKETS 1
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+// clang-format on
+
+// Don't raise SIGPIPE when a client disconnects mid response:
+#if defined(MSG_NOSIGNAL)
+static const int kSendFlags = MSG_NOSIGNAL;
+#else
+static const int kSendFlags = 0;
+#endif
+
+// Upper bound for raw requests (reject corrupt headers before allocating):
+static const int kMaxRawSize = 4096;
+
+// Requests in flight per connection (the reader stops reading beyond this):
+static const std::size_t kMaxPending = 16;
+
+// Raw pixel data in flight across all connections (request images and
+// response masks), raw requests beyond this are answered with a busy error:
+static const std::size_t kMaxRawBytes = std::size_t(128) << 20;
+
+struct RawBudget
+{
+    bool acquire(std::size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (used + bytes > kMaxRawBytes)
+        {
+            return false;
+        }
+        used += bytes;
+        return true;
+    }
+
+    void release(std::size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        used -= bytes;
+    }
+
+    std::mutex mutex;
+    std::size_t used = 0;
+};
+
+// clang-format off
+namespace detail
+{
+    template <typename Value, typename... Arguments>
+    std::unique_ptr<Value> make_unique(Arguments&&... arguments_for_constructor)
+    {
+        return std::unique_ptr<Value>(new Value(std::forward<Arguments>(arguments_for_constructor)...));
+    }
+}
+// clang-format on
+
+struct EyeServer::Impl
+{
+    struct Connection
+    {
+        Connection(int input, int output, bool isSocket, RawBudget& budget)
+            : input(input)
+            , output(output)
+            , isSocket(isSocket)
+            , budget(budget)
+        {
+            writer = std::thread([this]() { drain(); });
+        }
+
+        ~Connection()
+        {
+            close();
+#if defined(DRISHTI_SDK_TEST_HAVE_UNIX_SOCKETS)
+            if (isSocket)
+            {
+                ::close(input);
+            }
+#endif
+        }
+
+        // Responses are queued for the connection's own writer thread, so the
+        // segmentation workers never block on a client that isn't reading.
+        // Each response releases the slot of an acquire() once it is written,
+        // along with the raw budget bytes it holds (the mask):
+        void write(const std::string& text, const cv::Mat1b& mask = {}, std::size_t bytes = 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                outbox.push_back({ text, mask, bytes });
+            }
+            ready.notify_one();
+        }
+
+        // Reserve a response slot, blocks while the connection has too many
+        // requests in flight (only this client stalls, since its reader stops):
+        void acquire()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [this] { return pending < kMaxPending; });
+            pending++;
+        }
+
+        // Wait for the queued responses to be written, then stop the writer:
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closing = true;
+            }
+            ready.notify_one();
+
+            if (writer.joinable())
+            {
+                writer.join();
+            }
+        }
+
+        void drain()
+        {
+            bool failed = false; // the client is gone, discard the remaining responses
+            while (true)
+            {
+                Response response;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [this] { return !outbox.empty() || closing; });
+                    if (outbox.empty())
+                    {
+                        break;
+                    }
+                    response = std::move(outbox.front());
+                    outbox.pop_front();
+                }
+
+                const auto& mask = response.mask;
+                failed = failed || !(writeAll(response.text.data(), response.text.size()) && (mask.empty() || writeAll(mask.ptr(), mask.total())));
+                response.mask.release();
+                budget.release(response.bytes);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    pending--;
+                }
+                idle.notify_all();
+            }
+        }
+
+        bool writeAll(const void* data, std::size_t size)
+        {
+#if defined(DRISHTI_SDK_TEST_HAVE_UNIX_SOCKETS)
+            const char* ptr = static_cast<const char*>(data);
+            for (std::size_t offset = 0; offset < size;)
+            {
+                const auto count = isSocket ? ::send(output, ptr + offset, size - offset, kSendFlags) : ::write(output, ptr + offset, size - offset);
+                if ((count < 0) && (errno == EINTR))
+                {
+                    continue;
+                }
+                if (count <= 0)
+                {
+                    return false;
+                }
+                offset += static_cast<std::size_t>(count);
+            }
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        // Buffered input (lines and raw pixel data):
+        bool fill()
+        {
+#if defined(DRISHTI_SDK_TEST_HAVE_UNIX_SOCKETS)
+            char data[4096];
+            while (true)
+            {
+                const auto count = ::read(input, data, sizeof(data));
+                if ((count < 0) && (errno == EINTR))
+                {
+                    continue;
+                }
+                if (count <= 0)
+                {
+                    return false;
+                }
+                buffer.append(data, static_cast<std::size_t>(count));
+                return true;
+            }
+#else
+            return false;
+#endif
+        }
+
+        bool readLine(std::string& line)
+        {
+            std::size_t end = 0;
+            while ((end = buffer.find('\n')) == std::string::npos)
+            {
+                if (!fill())
+                {
+                    return false;
+                }
+            }
+
+            line = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            return true;
+        }
+
+        bool readBytes(void* data, std::size_t size)
+        {
+            while (buffer.size() < size)
+            {
+                if (!fill())
+                {
+                    return false;
+                }
+            }
+
+            std::copy(buffer.begin(), buffer.begin() + size, static_cast<char*>(data));
+            buffer.erase(0, size);
+            return true;
+        }
+
+        // Discard a payload that won't be processed (to keep the stream in sync):
+        bool skipBytes(std::size_t size)
+        {
+            while (size > 0)
+            {
+                if (buffer.empty() && !fill())
+                {
+                    return false;
+                }
+
+                const auto count = std::min(size, buffer.size());
+                buffer.erase(0, count);
+                size -= count;
+            }
+            return true;
+        }
+
+        struct Response
+        {
+            std::string text;
+            cv::Mat1b mask;
+            std::size_t bytes; // raw budget
+        };
+
+        int input;
+        int output;
+        bool isSocket;
+        RawBudget& budget;
+        std::string buffer;
+
+        std::mutex mutex;
+        std::condition_variable ready; // responses are queued (or closing)
+        std::condition_variable idle;  // a response was written
+        std::deque<Response> outbox;
+        std::size_t pending = 0; // responses not yet written (guarded by mutex)
+        bool closing = false;
+        std::thread writer;
+    };
+
+    struct Job
+    {
+        std::shared_ptr<Connection> connection;
+        std::string id;
+        bool isRight;
+        cv::Mat image;         // raw request
+        std::size_t bytes = 0; // raw budget held by the image and mask
+        std::string filename;  // path request
+        std::string maskname;  // optional mask output (path request)
+    };
+
+    Impl(std::shared_ptr<spdlog::logger>& logger, const std::string& model, std::size_t threads, int width)
+        : logger(logger)
+        , width(width)
+        , capacity(std::max(threads, std::size_t(1)) * 4)
+    {
+        // Load all segmenters up front so that model errors are reported here:
+        for (std::size_t i = 0; i < std::max(threads, std::size_t(1)); i++)
+        {
+            auto segmenter = std::make_shared<drishti::sdk::EyeSegmenter>(model);
+            if (!(*segmenter))
+            {
+                throw std::runtime_error("EyeServer: unable to load eye model " + model);
+            }
+            segmenters.push_back(segmenter);
+        }
+
+        for (auto& segmenter : segmenters)
+        {
+            workers.emplace_back([this, segmenter]() { loop(*segmenter); });
+        }
+    }
+
+    ~Impl()
+    {
+        stop();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        cv.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    // Queue a job (blocks while the queue is full, so fast clients can't exhaust memory):
+    void post(Job&& job)
+    {
+        job.connection->acquire();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        space.wait(lock, [this] { return queue.size() < capacity; });
+        queue.push_back(std::move(job));
+        lock.unlock();
+        cv.notify_one();
+    }
+
+    void loop(drishti::sdk::EyeSegmenter& segmenter)
+    {
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return !queue.empty() || !running; });
+                if (queue.empty())
+                {
+                    break; // stopped and drained
+                }
+
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            space.notify_one();
+
+            process(segmenter, job);
+            processed++;
+
+            job.image.release();
+            budget.release(job.bytes);
+        }
+    }
+
+    void process(drishti::sdk::EyeSegmenter& segmenter, Job& job)
+    {
+        const auto tic = std::chrono::high_resolution_clock::now();
+
+        nlohmann::json response;
+        response["id"] = job.id;
+
+        cv::Mat image = job.image.empty() ? cv::imread(job.filename, cv::IMREAD_COLOR) : job.image;
+
+        drishti::sdk::Eye eye;
+        cv::Mat1b mask;
+        if (image.empty())
+        {
+            job.connection->write(error(job.id, "unable to read image " + job.filename));
+            return;
+        }
+        else if (!segment(segmenter, image, job.isRight, eye, mask, width))
+        {
+            job.connection->write(error(job.id, "unable to segment image"));
+            return;
+        }
+
+        const auto toc = std::chrono::high_resolution_clock::now();
+        response["ok"] = true;
+        response["side"] = job.isRight ? "right" : "left";
+        response["ms"] = std::chrono::duration<double, std::milli>(toc - tic).count();
+
+        const auto parameters = toJson(eye);
+        try
+        {
+            response["eye"] = nlohmann::json::parse(parameters);
+        }
+        catch (const std::exception&)
+        {
+            response["eye"] = parameters; // pass through as a string
+        }
+
+        if (!job.image.empty())
+        {
+            // The mask holds its share of the budget until it is written:
+            const std::size_t bytes = std::min(job.bytes, mask.total());
+            job.bytes -= bytes;
+            response["mask_bytes"] = mask.total();
+            job.connection->write(response.dump() + "\n", mask, bytes);
+            return;
+        }
+
+        if (!job.maskname.empty())
+        {
+            if (!cv::imwrite(job.maskname, mask))
+            {
+                job.connection->write(error(job.id, "unable to write mask " + job.maskname));
+                return;
+            }
+            response["mask"] = job.maskname;
+        }
+        job.connection->write(response.dump() + "\n");
+    }
+
+    static std::string error(const std::string& id, const std::string& message)
+    {
+        nlohmann::json response;
+        response["id"] = id;
+        response["ok"] = false;
+        response["error"] = message;
+        return response.dump() + "\n";
+    }
+
+    // Parse requests until the input ends, then wait for the responses:
+    void read(const std::shared_ptr<Connection>& connection)
+    {
+        std::string line;
+        while (connection->readLine(line))
+        {
+            std::istringstream iss(line);
+            std::vector<std::string> args{ std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>() };
+            if (args.empty())
+            {
+                continue;
+            }
+
+            Job job;
+            job.connection = connection;
+
+            if (args.front() == "raw")
+            {
+                // raw <id> <width> <height> <channels> <left|right>
+                int width = 0, height = 0, channels = 0;
+                if (args.size() == 6)
+                {
+                    job.id = args[1];
+                    width = std::atoi(args[2].c_str());
+                    height = std::atoi(args[3].c_str());
+                    channels = std::atoi(args[4].c_str());
+                }
+
+                const bool isValid = (width > 0) && (width <= kMaxRawSize) && (height > 0) && (height <= kMaxRawSize);
+                if (!isValid || !((channels == 1) || (channels == 3) || (channels == 4)) || !isSide(args.back()))
+                {
+                    // The payload size is unknown, so the stream can't be resynchronized:
+                    connection->acquire();
+                    connection->write(error(job.id, "expected: raw <id> <width> <height> <1|3|4> <left|right>"));
+                    break;
+                }
+
+                // Reserve the image and the mask (width * height) before allocating:
+                const std::size_t size = std::size_t(width) * height * channels;
+                const std::size_t bytes = size + std::size_t(width) * height;
+                if (!budget.acquire(bytes))
+                {
+                    connection->acquire();
+                    connection->write(error(job.id, "server busy: too much raw data in flight, retry later"));
+                    if (!connection->skipBytes(size))
+                    {
+                        break;
+                    }
+                    continue;
+                }
+
+                job.bytes = bytes;
+                job.isRight = (args.back() == "right");
+                job.image.create(height, width, CV_8UC(channels));
+                if (!connection->readBytes(job.image.ptr(), size))
+                {
+                    budget.release(bytes);
+                    break;
+                }
+            }
+            else
+            {
+                // <id> <image> <left|right> [<mask.png>]
+                if (((args.size() != 3) && (args.size() != 4)) || !isSide(args[2]))
+                {
+                    connection->acquire();
+                    connection->write(error(args.front(), "expected: <id> <image> <left|right> [<mask.png>]"));
+                    continue;
+                }
+
+                job.id = args[0];
+                job.filename = args[1];
+                job.isRight = (args[2] == "right");
+                job.maskname = (args.size() == 4) ? args[3] : std::string();
+            }
+
+            post(std::move(job));
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(connection->mutex);
+            connection->idle.wait(lock, [&] { return connection->pending == 0; });
+        }
+        connection->close();
+    }
+
+    static bool isSide(const std::string& side)
+    {
+        return (side == "left") || (side == "right");
+    }
+
+#if defined(DRISHTI_SDK_TEST_HAVE_UNIX_SOCKETS)
+    bool serve(int input, int output)
+    {
+        read(std::make_shared<Connection>(input, output, false, budget));
+        return true;
+    }
+
+    bool start(const std::string& filename)
+    {
+        sockaddr_un address{};
+        if (filename.size() >= sizeof(address.sun_path))
+        {
+            logger->error("Server socket path is too long: {}", filename);
+            return false;
+        }
+
+        address.sun_family = AF_UNIX;
+        std::copy(filename.begin(), filename.end(), address.sun_path);
+
+        listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0)
+        {
+            logger->error("Failed to create server socket");
+            return false;
+        }
+
+        ::unlink(filename.c_str()); // remove stale socket from a previous run
+        if ((::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) || (::listen(listener, 16) != 0))
+        {
+            logger->error("Failed to bind server socket {}", filename);
+            ::close(listener);
+            listener = -1;
+            return false;
+        }
+
+        path = filename;
+        accepting = true;
+        thread = std::thread([this] { accept(); });
+        logger->info("Listening for eye segmentation requests on {}", path);
+        return true;
+    }
+
+    void stop()
+    {
+        accepting = false;
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+
+        // Unblock the readers, queued requests are still processed:
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& connection : connections)
+            {
+                if (auto ptr = connection.lock())
+                {
+                    ::shutdown(ptr->input, SHUT_RDWR);
+                }
+            }
+            connections.clear();
+        }
+
+        for (auto& reader : readers)
+        {
+            reader.thread.join();
+        }
+        readers.clear();
+
+        if (listener >= 0)
+        {
+            ::close(listener);
+            ::unlink(path.c_str());
+            listener = -1;
+        }
+    }
+
+    // Join the readers of closed connections (clients can connect per request):
+    void reap()
+    {
+        for (auto iter = readers.begin(); iter != readers.end();)
+        {
+            if (*iter->done)
+            {
+                iter->thread.join();
+                iter = readers.erase(iter);
+            }
+            else
+            {
+                iter++;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        connections.erase(std::remove_if(connections.begin(), connections.end(), [](const std::weak_ptr<Connection>& connection) {
+            return connection.expired();
+        }), connections.end());
+    }
+
+    void accept()
+    {
+        while (accepting)
+        {
+            reap();
+
+            // Use a short timeout so that stop() is handled promptly:
+            pollfd fds{ listener, POLLIN, 0 };
+            if ((::poll(&fds, 1, 100) <= 0) || !(fds.revents & POLLIN))
+            {
+                continue;
+            }
+
+            const int fd = ::accept(listener, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                auto connection = std::make_shared<Connection>(fd, fd, true, budget);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    connections.push_back(connection);
+                }
+                auto done = std::make_shared<std::atomic<bool>>(false);
+                readers.push_back({ std::thread([this, connection, done]() {
+                                       read(connection);
+                                       *done = true;
+                                   }),
+                    done });
+            }
+        }
+    }
+
+    struct Reader
+    {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+
+    int listener = -1;
+    std::vector<Reader> readers; // one per client
+#else
+    bool serve(int input, int output)
+    {
+        logger->error("Server mode is not supported on this platform");
+        return false;
+    }
+
+    bool start(const std::string& filename)
+    {
+        logger->error("Server sockets are not supported on this platform");
+        return false;
+    }
+
+    void stop() {}
+#endif
+
+    std::shared_ptr<spdlog::logger> logger;
+    int width = 0; // segmentation width (0 == image width)
+    std::vector<std::shared_ptr<drishti::sdk::EyeSegmenter>> segmenters;
+    std::vector<std::thread> workers;
+
+    std::size_t capacity;
+    std::mutex mutex;
+    std::condition_variable cv;    // jobs are available
+    std::condition_variable space; // the queue has room
+    std::deque<Job> queue;
+    bool running = true;
+
+    RawBudget budget; // raw pixel data in flight (all connections)
+
+    std::string path;
+    std::atomic<bool> accepting{ false };
+    std::thread thread;                                 // accept loop
+    std::vector<std::weak_ptr<Connection>> connections; // for shutdown
+
+    std::atomic<std::size_t> processed{ 0 };
+};
+
+EyeServer::EyeServer(std::shared_ptr<spdlog::logger>& logger, const std::string& model, std::size_t threads, int width)
+{
+    m_impl = detail::make_unique<Impl>(logger, model, threads, width);
+}
+
+EyeServer::~EyeServer() = default;
+
+bool EyeServer::serve(int input, int output)
+{
+    return m_impl->serve(input, output);
+}
+
+bool EyeServer::start(const std::string& path)
+{
+    return m_impl->start(path);
+}
+
+void EyeServer::stop()
+{
+    m_impl->stop();
+}
+
+std::size_t EyeServer::processed() const
+{
+    return m_impl->processed;
+}
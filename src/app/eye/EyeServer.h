@@ -0,0 +1,61 @@
+/*!
+  @file   EyeServer.h
+  @author David Hirvonen
+  @brief  Persistent eye segmentation server (stdin/stdout or Unix domain socket).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  The models are loaded once (one EyeSegmenter per worker thread) and each
+  connection can have several requests in flight (a client that doesn't read
+  its responses stops being read once it reaches the limit, without stalling
+  the other clients).  Requests are single lines:
+
+    <id> <image> <left|right> [<mask.png>]
+    raw <id> <width> <height> <channels> <left|right>\n<width*height*channels bytes>
+
+  Raw pixel buffers are 8 bit gray, BGR or BGRA (row major, no padding).  Each
+  request is answered with a single line of JSON, in completion order:
+
+    {"id":"7","ok":true,"side":"right","ms":3.1,"eye":{...},"mask":"7.png"}
+    {"id":"8","ok":true,"side":"left","ms":2.9,"eye":{...},"mask_bytes":4096}
+    {"id":"9","ok":false,"error":"unable to read image"}
+
+  Raw requests are answered with the raw mask (width*height bytes) directly
+  after the JSON line.  Path requests write the mask to the optional path.
+  Raw images are limited to 4096x4096, and the raw data in flight (images and
+  masks of all clients) is bounded, so a raw request that would exceed the
+  limit is answered with an error (and its payload is discarded).
+
+*/
+
+#ifndef __EyeServer_h__
+#define __EyeServer_h__
+
+#include <spdlog/spdlog.h> // for portable logging
+
+#include <memory>
+#include <string>
+
+class EyeServer
+{
+public:
+    // Images wider than width (> 0) are segmented at that width (see segment()):
+    EyeServer(std::shared_ptr<spdlog::logger>& logger, const std::string& model, std::size_t threads, int width = 0);
+    ~EyeServer(); // stop() and join
+
+    // Serve a single stream pair (i.e., stdin and stdout) until the input ends:
+    bool serve(int input, int output);
+
+    // Accept clients on a Unix domain socket (in the background) until stop():
+    bool start(const std::string& path);
+    void stop();
+
+    std::size_t processed() const; // completed requests (including errors)
+
+protected:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+#endif // __EyeServer_h__
@@ -9,19 +9,34 @@
 */
 
 #include <drishti/EyeSegmenter.hpp>
-#include <drishti/EyeIO.hpp>
+
 #include <drishti/drishti_cv.hpp>
 
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 
+#include "EyeSegment.h"
+#include "EyeServer.h"
+#include "PerfReport.h"
+
 #include <cxxopts.hpp>
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
 #include <fstream>
+#include <thread>
 
-static std::shared_ptr<spdlog::logger> createLogger(const char* name);
+static std::shared_ptr<spdlog::logger> createLogger(const char* name, bool useStderr = false);
+static void logError(spdlog::logger& logger, const drishti::sdk::Eye& reference, const cv::Mat1b& referenceMask, const drishti::sdk::Eye& eye, const cv::Mat1b& mask);
+
+// Stop the socket server (i.e., kill -TERM <pid>):
+static std::atomic<bool> gDoStop{ false };
+static void requestStop(int) { gDoStop = true; }
 
 int gauze_main(int argc, char** argv)
 {
@@ -29,7 +44,11 @@ int gauze_main(int argc, char** argv)
 
     bool isRight = false;
     bool isLeft = false;
-    std::string sInput, sOutput, sModel;
+    int repeat = 1;
+    bool doServe = false;
+    int threads = 2;
+    int width = 0;
+    std::string sInput, sOutput, sModel, sSocket;
 
     cxxopts::Options options("drishti-eye-test", "Command line interface for eye model fitting");
 
@@ -40,9 +59,19 @@ int gauze_main(int argc, char** argv)
         ("o,output", "Output image", cxxopts::value<std::string>(sOutput))
         ("m,model", "Eye model (pose regression)", cxxopts::value<std::string>(sModel))
         ("r,right", "Right eye", cxxopts::value<bool>(isRight))
-        ("l,left", "Left eye", cxxopts::value<bool>(isLeft));
+        ("l,left", "Left eye", cxxopts::value<bool>(isLeft))
+        ("repeat", "Run the segmentation N times (for timing)", cxxopts::value<int>(repeat))
+        ("width", "Segment at this width (area resize), the mask stays at full resolution", cxxopts::value<int>(width))
+
+        // server mode (the model stays loaded, see EyeServer.h for the protocol):
+        ("serve", "Serve requests on stdin (responses on stdout)", cxxopts::value<bool>(doServe))
+        ("socket", "Serve requests on a Unix domain socket", cxxopts::value<std::string>(sSocket))
+        ("threads", "Server worker threads (one segmenter each)", cxxopts::value<int>(threads));
     // clang-format on    
 
+    PerfReport::Settings perf;
+    PerfReport::addOptions(options, perf);
+
     options.parse(argc, argv);
     if ((argumentCount <= 1) || options.count("help"))
     {
@@ -50,8 +79,42 @@ int gauze_main(int argc, char** argv)
         return 0;
     }
 
-    auto logger = createLogger("drishti-eye-test");
-    
+    // Responses are written to stdout in stdin server mode:
+    auto logger = createLogger("drishti-eye-test", doServe);
+
+    if (doServe || !sSocket.empty())
+    {
+        if (sModel.empty())
+        {
+            logger->error("Must specify model {}", sModel);
+            return 1;
+        }
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        EyeServer server(logger, sModel, static_cast<std::size_t>(std::max(threads, 1)), width);
+        const auto stop = std::chrono::high_resolution_clock::now();
+        logger->info("Loaded {} segmenters in {} seconds", std::max(threads, 1), std::chrono::duration<double>(stop - start).count());
+
+        bool ok = true;
+        if (doServe)
+        {
+            ok = server.serve(0, 1);
+        }
+        else if ((ok = server.start(sSocket)))
+        {
+            std::signal(SIGINT, requestStop);
+            std::signal(SIGTERM, requestStop);
+            while (!gDoStop)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            server.stop();
+        }
+
+        logger->info("Processed {} requests", server.processed());
+        return ok ? 0 : 1;
+    }
+
     if (sInput.empty())
     {
         logger->error("Must specify input {}", sInput);
@@ -92,15 +155,44 @@ int gauze_main(int argc, char** argv)
         return 1;
     }
 
-    auto image_ = drishti::sdk::cvToDrishti<cv::Vec3b, drishti::sdk::Vec3b>(image);
     drishti::sdk::Eye eye;
-    segmenter(image_, eye, isRight);
+    cv::Mat1b mask;
 
-    cv::Mat1b mask(image.size(), 0);
-    auto mask_ = drishti::sdk::cvToDrishti<uint8_t, uint8_t>(mask);
+    // Time repeated segmentation at a working width (0 == full resolution):
+    const auto run = [&](int workingWidth, drishti::sdk::Eye& result, cv::Mat1b& resultMask) {
+        PerfReport report;
+        const auto tic = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < std::max(repeat, 1); i++)
+        {
+            const auto start = std::chrono::high_resolution_clock::now();
+            segment(segmenter, image, isRight, result, resultMask, workingWidth);
+            const auto stop = std::chrono::high_resolution_clock::now();
+            report.add(std::chrono::duration<double>(stop - start).count());
+        }
+        report.setElapsed(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tic).count());
+        return report;
+    };
+
+    const auto report = run(width, eye, mask);
+
+    if ((width > 0) && (image.cols > width))
+    {
+        // Compare with full resolution processing:
+        drishti::sdk::Eye reference;
+        cv::Mat1b referenceMask;
+        const auto full = run(0, reference, referenceMask);
 
-    const int maskKind = static_cast<int>(drishti::sdk::kScleraRegion) | static_cast<int>(drishti::sdk::kIrisRegion);
-    drishti::sdk::createMask(mask_, eye, maskKind);
+        const double p50 = report.getPercentile(0.5), fullP50 = full.getPercentile(0.5);
+        logger->info(
+            "Width {} ({}x{} source): p50 {:.3f} ms vs {:.3f} ms at full resolution ({:.2f}x throughput)",
+            width,
+            image.cols,
+            image.rows,
+            p50 * 1e3,
+            fullP50 * 1e3,
+            (p50 > 0.0) ? (fullP50 / p50) : 0.0);
+        logError(*logger, reference, referenceMask, eye, mask);
+    }
 
     // Output mask image:
     cv::imwrite(sOutput + "/mask.png", mask);
@@ -111,14 +203,14 @@ int gauze_main(int argc, char** argv)
     std::ofstream ofs(parameters);    
     if (ofs)
     {
-        ofs << drishti::sdk::EyeOStream(eye, drishti::sdk::EyeOStream::JSON);
+        ofs << toJson(eye);
     }
     else
     {
         logger->error("Unable to write file: {}", parameters);
     }
 
-    return 0;
+    return report.finish(perf, *logger);
 }
 
 #if !defined(DRISHTI_SDK_TEST_BUILD_TESTS)
@@ -138,10 +230,45 @@ int main(int argc, char **argv)
 }
 #endif
 
-static std::shared_ptr<spdlog::logger> createLogger(const char *name)
+// Geometric error of an eye model relative to a reference (source pixels):
+static void logError(spdlog::logger& logger, const drishti::sdk::Eye& reference, const cv::Mat1b& referenceMask, const drishti::sdk::Eye& eye, const cv::Mat1b& mask)
+{
+    const auto irisA = drishti::sdk::drishtiToCv(reference.getIris());
+    const auto irisB = drishti::sdk::drishtiToCv(eye.getIris());
+    const double center = cv::norm(irisA.center - irisB.center);
+    const double radius = std::abs((irisA.size.width + irisA.size.height) - (irisB.size.width + irisB.size.height)) * 0.25;
+
+    double eyelids = 0.0;
+    const auto eyelidsA = drishti::sdk::drishtiToCv(reference.getEyelids());
+    const auto eyelidsB = drishti::sdk::drishtiToCv(eye.getEyelids());
+    if (!eyelidsA.empty() && (eyelidsA.size() == eyelidsB.size()))
+    {
+        for (std::size_t i = 0; i < eyelidsA.size(); i++)
+        {
+            eyelids += cv::norm(eyelidsA[i] - eyelidsB[i]);
+        }
+        eyelids /= eyelidsA.size();
+    }
+
+    // Mask agreement (intersection over union):
+    const int intersection = cv::countNonZero(referenceMask & mask);
+    const int area = cv::countNonZero(referenceMask | mask);
+    const double iou = area ? (static_cast<double>(intersection) / area) : 1.0;
+
+    logger.info("Error: iris center {:.2f} px, iris radius {:.2f} px, eyelids {:.2f} px (mean), mask IoU {:.4f}", center, radius, eyelids, iou);
+}
+
+static std::shared_ptr<spdlog::logger> createLogger(const char *name, bool useStderr)
 {
     std::vector<spdlog::sink_ptr> sinks;
-    sinks.push_back(std::make_shared<spdlog::sinks::stdout_sink_mt>());
+    if (useStderr)
+    {
+        sinks.push_back(std::make_shared<spdlog::sinks::stderr_sink_mt>());
+    }
+    else
+    {
+        sinks.push_back(std::make_shared<spdlog::sinks::stdout_sink_mt>());
+    }
 #if defined(__ANDROID__)
     sinks.push_back(std::make_shared<spdlog::sinks::android_sink>());
 #endif
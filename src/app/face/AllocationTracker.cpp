@@ -0,0 +1,297 @@
+/*!
+  @file   AllocationTracker.cpp
+  @author David Hirvonen
+  @brief  Heap allocation counters per pipeline stage (instrumentation builds).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+
+// clang-format off
+#if defined(DRISHTI_SDK_TEST_TRACK_ALLOCATIONS) && defined(__GLIBC__)
+#  define DRISHTI_SDK_TEST_HOOK_MALLOC 1
+#  include <cerrno>
+#  include <malloc.h>
+extern "C"
+{
+    void* __libc_malloc(std::size_t size);
+    void* __libc_calloc(std::size_t count, std::size_t size);
+    void* __libc_realloc(void* ptr, std::size_t size);
+    void* __libc_memalign(std::size_t alignment, std::size_t size);
+    void* __libc_valloc(std::size_t size);
+    void* __libc_pvalloc(std::size_t size);
+    void __libc_free(void* ptr);
+}
+#endif
+
+#if defined(__linux__)
+#  include <unistd.h>
+#endif
+// clang-format on
+
+// Everything here is written from inside the allocator, so it must be
+// constant initialized and must not allocate.
+namespace
+{
+    const int kOther = static_cast<int>(PipelineStage::kCount);
+
+    struct Counters
+    {
+        std::atomic<std::uint64_t> count;
+        std::atomic<std::uint64_t> bytes;
+        std::atomic<std::uint64_t> peakHeap; // peak live heap while in this stage
+    };
+
+    Counters gStages[kOther + 1];
+    std::atomic<std::uint64_t> gHeap{ 0 };
+    std::atomic<std::uint64_t> gPeakHeap{ 0 };
+    std::atomic<std::uint64_t> gPeakRss{ 0 };
+
+    thread_local int gThreadStage = kOther;
+    thread_local std::uint64_t gThreadAllocations = 0;
+
+    void updateMax(std::atomic<std::uint64_t>& value, std::uint64_t sample)
+    {
+        auto current = value.load(std::memory_order_relaxed);
+        while ((sample > current) && !value.compare_exchange_weak(current, sample, std::memory_order_relaxed))
+        {
+        }
+    }
+
+#if defined(DRISHTI_SDK_TEST_TRACK_ALLOCATIONS)
+    void onAllocate(std::size_t bytes)
+    {
+        gThreadAllocations++;
+
+        auto& stage = gStages[gThreadStage];
+        stage.count.fetch_add(1, std::memory_order_relaxed);
+        stage.bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+        const auto heap = gHeap.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        updateMax(gPeakHeap, heap);
+        updateMax(stage.peakHeap, heap);
+    }
+
+    // Saturate at zero, in case a block was allocated through an entry point
+    // that isn't interposed (the live heap is then an underestimate):
+    void onFree(std::size_t bytes)
+    {
+        auto current = gHeap.load(std::memory_order_relaxed);
+        while (!gHeap.compare_exchange_weak(current, current - std::min<std::uint64_t>(current, bytes), std::memory_order_relaxed))
+        {
+        }
+    }
+#endif
+}
+
+#if defined(DRISHTI_SDK_TEST_HOOK_MALLOC)
+
+// glibc: interpose the C allocator (operator new and cv::fastMalloc end up here).
+// Sizes are measured with malloc_usable_size() so the live heap balances.
+
+extern "C" void* malloc(std::size_t size)
+{
+    void* ptr = __libc_malloc(size);
+    if (ptr)
+    {
+        onAllocate(malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+extern "C" void* calloc(std::size_t count, std::size_t size)
+{
+    void* ptr = __libc_calloc(count, size);
+    if (ptr)
+    {
+        onAllocate(malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+extern "C" void* realloc(void* ptr, std::size_t size)
+{
+    const std::size_t before = ptr ? malloc_usable_size(ptr) : 0;
+    void* result = __libc_realloc(ptr, size);
+    if (result)
+    {
+        onFree(before);
+        onAllocate(malloc_usable_size(result));
+    }
+    else if (ptr && (size == 0))
+    {
+        onFree(before); // realloc(ptr, 0) == free(ptr)
+    }
+    return result;
+}
+
+extern "C" int posix_memalign(void** result, std::size_t alignment, std::size_t size)
+{
+    void* ptr = __libc_memalign(alignment, size);
+    if (!ptr)
+    {
+        return ENOMEM;
+    }
+    onAllocate(malloc_usable_size(ptr));
+    *result = ptr;
+    return 0;
+}
+
+// The remaining aligned entry points, so that every block free() sees was counted:
+
+static void* counted(void* ptr)
+{
+    if (ptr)
+    {
+        onAllocate(malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+extern "C" void* aligned_alloc(std::size_t alignment, std::size_t size)
+{
+    return counted(__libc_memalign(alignment, size));
+}
+
+extern "C" void* memalign(std::size_t alignment, std::size_t size)
+{
+    return counted(__libc_memalign(alignment, size));
+}
+
+extern "C" void* valloc(std::size_t size)
+{
+    return counted(__libc_valloc(size));
+}
+
+extern "C" void* pvalloc(std::size_t size)
+{
+    return counted(__libc_pvalloc(size));
+}
+
+extern "C" void free(void* ptr)
+{
+    if (ptr)
+    {
+        onFree(malloc_usable_size(ptr));
+        __libc_free(ptr);
+    }
+}
+
+#elif defined(DRISHTI_SDK_TEST_TRACK_ALLOCATIONS)
+
+// Other platforms: count operator new only (no live heap tracking).
+
+void* operator new(std::size_t size)
+{
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    onAllocate(size);
+    return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+#endif
+
+bool AllocationTracker::isEnabled()
+{
+#if defined(DRISHTI_SDK_TEST_TRACK_ALLOCATIONS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+int AllocationTracker::enter(PipelineStage stage)
+{
+    const int previous = gThreadStage;
+    gThreadStage = static_cast<int>(stage);
+    return previous;
+}
+
+void AllocationTracker::leave(int previous)
+{
+    gThreadStage = previous;
+}
+
+std::uint64_t AllocationTracker::getThreadAllocations()
+{
+    return gThreadAllocations;
+}
+
+std::uint64_t AllocationTracker::getHeapBytes()
+{
+    return gHeap.load(std::memory_order_relaxed);
+}
+
+std::uint64_t AllocationTracker::getPeakHeapBytes()
+{
+    return gPeakHeap.load(std::memory_order_relaxed);
+}
+
+std::uint64_t AllocationTracker::sampleRss()
+{
+    std::uint64_t rss = 0;
+#if defined(__linux__)
+    // /proc/self/statm: size resident shared text lib data dt (pages)
+    if (FILE* file = std::fopen("/proc/self/statm", "r"))
+    {
+        unsigned long size = 0, resident = 0;
+        if (std::fscanf(file, "%lu %lu", &size, &resident) == 2)
+        {
+            rss = static_cast<std::uint64_t>(resident) * static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+        }
+        std::fclose(file);
+    }
+#endif
+    updateMax(gPeakRss, rss);
+    return rss;
+}
+
+void AllocationTracker::report(std::ostream& os)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    os << "alloc.heap_bytes " << getHeapBytes() << "\n";
+    os << "alloc.heap_bytes.peak " << getPeakHeapBytes() << "\n";
+    os << "alloc.rss_bytes.peak " << gPeakRss.load(std::memory_order_relaxed) << "\n";
+
+    for (int i = 0; i <= kOther; i++)
+    {
+        const auto& stage = gStages[i];
+        const char* name = (i == kOther) ? "other" : toString(static_cast<PipelineStage>(i));
+        os << "alloc.stage." << name << ".count " << stage.count.load(std::memory_order_relaxed) << "\n";
+        os << "alloc.stage." << name << ".bytes " << stage.bytes.load(std::memory_order_relaxed) << "\n";
+        os << "alloc.stage." << name << ".peak_heap " << stage.peakHeap.load(std::memory_order_relaxed) << "\n";
+    }
+}
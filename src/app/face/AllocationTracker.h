@@ -0,0 +1,47 @@
+/*!
+  @file   AllocationTracker.h
+  @author David Hirvonen
+  @brief  Heap allocation counters per pipeline stage (instrumentation builds).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  With DRISHTI_SDK_TEST_TRACK_ALLOCATIONS the global operator new/delete
+  (and on glibc malloc/calloc/realloc/free and the aligned variants) are
+  replaced with counting wrappers.  Allocations are attributed to the
+  innermost ScopedStage of the allocating thread ("other" outside of any
+  stage).  Without the build option the functions are no-ops.
+
+*/
+
+#ifndef __AllocationTracker_h__
+#define __AllocationTracker_h__
+
+#include "PipelineStage.h"
+
+#include <cstdint>
+#include <iosfwd>
+
+class AllocationTracker
+{
+public:
+    static bool isEnabled();
+
+    // Attribute allocations on this thread to a stage, returns the previous stage:
+    static int enter(PipelineStage stage);
+    static void leave(int previous);
+
+    // Allocations made by the calling thread (monotonic):
+    static std::uint64_t getThreadAllocations();
+
+    static std::uint64_t getHeapBytes();     // live heap (glibc)
+    static std::uint64_t getPeakHeapBytes(); // peak live heap (glibc)
+
+    // Sample the resident set size (bytes), the peak is kept for the report:
+    static std::uint64_t sampleRss();
+
+    // Write "key value" lines:
+    static void report(std::ostream& os);
+};
+
+#endif // __AllocationTracker_h__
@@ -1,14 +1,23 @@
 /*!
   @file   AsyncWorker
   @author David Hirvonen
-  @brief  Simple asynchronous worker (1 item job queue)
+  @brief  Simple asynchronous worker (bounded job queue)
+
+  Jobs run in order on one thread.  post() returns as soon as the job is
+  queued, and blocks only while the queue is full, so a slow consumer throttles
+  the producer instead of growing the queue (capacity 1 lets the producer
+  prepare the next job while the current one runs).
 
   \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
   \license{This project is released under the 3 Clause BSD License.}
 
 */
 
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <mutex>
+#include <thread>
 #include <condition_variable>
 
 #ifndef __AsyncWorker_h__
@@ -19,21 +28,39 @@ struct AsyncWorker
 {
     void loop()
     {
-        while (running)
+        if (init)
         {
-            // Wait until main() sends data:
-            std::unique_lock<std::mutex> lock(mutex);
-            cv.wait(lock, [this] { return this->ready; });
+            init(); // i.e., thread name, affinity
+        }
+
+        while (true)
+        {
+            Callable action;
+
+            {
+                // Wait until main() sends data (or asks us to stop):
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return !this->queue.empty() || !this->running; });
+                if (queue.empty())
+                {
+                    break; // stopped and drained
+                }
+
+                action = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            // Wake up any producer waiting for room in the queue:
+            cv.notify_all();
 
             // call the callback/lambda:
             action();
-            ready = false;
-            processed = true;
 
-            // Manual unlocking is done before notifying, to avoid waking up
-            // the waiting thread only to block again (see notify_one for details):
-            lock.unlock();
-            cv.notify_one();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending--;
+            }
+            idle.notify_all();
         }
     }
 
@@ -42,37 +69,56 @@ struct AsyncWorker
         worker = std::thread([&] { loop(); });
     }
 
+    // Process all queued jobs, then join the worker thread:
     void stop()
     {
-        running = false;
-        post([] {}); // post sentinel
-    }
-
-    void post(const Callable& callback)
-    {
-        action = callback;
-
-        // send data to the worker thread:
         {
             std::lock_guard<std::mutex> lock(mutex);
-            ready = true;
+            running = false;
         }
-        cv.notify_one();
+        cv.notify_all();
 
-        // wait for the worker:
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+
+    // Queue a job, blocking while the queue is full (backpressure):
+    void post(const Callable& callback)
+    {
         {
             std::unique_lock<std::mutex> lock(mutex);
-            cv.wait(lock, [this] { return this->processed; });
+            cv.wait(lock, [this] { return this->queue.size() < this->capacity; });
+            queue.push_back(callback);
+            pending++;
         }
+        cv.notify_all();
     }
 
+    // Wait until all posted jobs have completed:
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return this->pending == 0; });
+    }
+
+    // Jobs that have been posted but not yet completed (lock-free read):
+    std::size_t depth() const { return pending; }
+
+    // Called on the worker thread before the first job (set before start()):
+    std::function<void()> init;
+
+    // Max number of queued jobs (not including the active job):
+    std::size_t capacity = 1;
+
     // Synchronization {
     std::mutex mutex;
     std::condition_variable cv;
-    bool ready = false;
-    bool processed = false;
+    std::condition_variable idle; // a job completed
+    std::deque<Callable> queue;
+    std::atomic<std::size_t> pending{ 0 };
     std::thread worker;
-    Callable action;
 
     bool running = true;
     //  }
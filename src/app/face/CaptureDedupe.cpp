@@ -0,0 +1,110 @@
+/*!
+  @file   CaptureDedupe.cpp
+  @author David Hirvonen
+  @brief  Perceptual hash (dHash) deduplication of captured frames and eye crops.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "CaptureDedupe.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <bitset>
+
+std::uint64_t CaptureDedupe::hash(const cv::Mat& image)
+{
+    if (image.empty())
+    {
+        return 0;
+    }
+
+    // Downsample first (INTER_AREA is vectorized), so the color conversion is on 72 pixels:
+    cv::Mat thumbnail, gray;
+    cv::resize(image, thumbnail, { 9, 8 }, 0, 0, cv::INTER_AREA);
+    switch (thumbnail.channels())
+    {
+        case 3:
+            cv::cvtColor(thumbnail, gray, cv::COLOR_BGR2GRAY);
+            break;
+        case 4:
+            cv::cvtColor(thumbnail, gray, cv::COLOR_BGRA2GRAY);
+            break;
+        default:
+            gray = thumbnail;
+            break;
+    }
+
+    std::uint64_t bits = 0;
+    for (int y = 0; y < 8; y++)
+    {
+        const auto* row = gray.ptr<std::uint8_t>(y);
+        for (int x = 0; x < 8; x++)
+        {
+            bits = (bits << 1) | static_cast<std::uint64_t>(row[x] < row[x + 1]);
+        }
+    }
+    return bits;
+}
+
+int CaptureDedupe::distance(std::uint64_t a, std::uint64_t b)
+{
+    return static_cast<int>(std::bitset<64>(a ^ b).count()); // popcount
+}
+
+CaptureDedupe::CaptureDedupe(int threshold, float radius, std::size_t capacity)
+    : threshold(threshold)
+    , radius(radius)
+    , capacity(std::max(capacity, std::size_t(1)))
+{
+}
+
+CaptureDedupe::Face& CaptureDedupe::find(const std::array<float, 3>& position)
+{
+    const auto dist2 = [&](const Face& face) {
+        const float dx = face.position[0] - position[0];
+        const float dy = face.position[1] - position[1];
+        const float dz = face.position[2] - position[2];
+        return dx * dx + dy * dy + dz * dz;
+    };
+
+    auto best = std::min_element(faces.begin(), faces.end(), [&](const Face& a, const Face& b) { return dist2(a) < dist2(b); });
+    if ((best != faces.end()) && (dist2(*best) < (radius * radius)))
+    {
+        best->position = position; // follow the subject
+        best->used = ++stamp;
+        return *best;
+    }
+
+    // New face (replace the least recently used one):
+    if (faces.size() >= capacity)
+    {
+        faces.erase(std::min_element(faces.begin(), faces.end(), [](const Face& a, const Face& b) { return a.used < b.used; }));
+    }
+    faces.push_back({ position, {}, {}, ++stamp });
+    return faces.back();
+}
+
+bool CaptureDedupe::isDuplicate(const std::array<float, 3>& position, Kind kind, const cv::Mat& image)
+{
+    if ((threshold < 0) || image.empty())
+    {
+        return false;
+    }
+
+    const auto bits = hash(image);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& face = find(position);
+    if (face.valid[kind] && (distance(face.hashes[kind], bits) < threshold))
+    {
+        return true;
+    }
+
+    face.hashes[kind] = bits;
+    face.valid[kind] = true;
+    return false;
+}
@@ -0,0 +1,68 @@
+/*!
+  @file   CaptureDedupe.h
+  @author David Hirvonen
+  @brief  Perceptual hash (dHash) deduplication of captured frames and eye crops.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  A 64 bit difference hash compares horizontally adjacent pixels of a 9x8
+  grayscale thumbnail.  Captures are grouped by face (the nearest recent
+  capture position) and a capture is a duplicate when the Hamming distance
+  of its hash to the last one written for that face is below the threshold
+  (0 disables the check, 1 only suppresses identical hashes).
+
+*/
+
+#ifndef __CaptureDedupe_h__
+#define __CaptureDedupe_h__
+
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class CaptureDedupe
+{
+public:
+    enum Kind
+    {
+        kFrame,
+        kEyes,
+        kKinds
+    };
+
+    // 64 bit difference hash (gray, BGR or BGRA):
+    static std::uint64_t hash(const cv::Mat& image);
+    static int distance(std::uint64_t a, std::uint64_t b);
+
+    // Captures within radius (meters) of each other belong to the same face:
+    CaptureDedupe(int threshold, float radius = 0.1f, std::size_t capacity = 8);
+
+    // Returns true if the image should be skipped, otherwise it becomes the
+    // reference for the face:
+    bool isDuplicate(const std::array<float, 3>& position, Kind kind, const cv::Mat& image);
+
+protected:
+    struct Face
+    {
+        std::array<float, 3> position;
+        std::array<std::uint64_t, kKinds> hashes;
+        std::array<bool, kKinds> valid;
+        std::uint64_t used; // LRU stamp
+    };
+
+    Face& find(const std::array<float, 3>& position);
+
+    int threshold;
+    float radius;
+    std::size_t capacity;
+
+    std::mutex mutex;
+    std::vector<Face> faces;
+    std::uint64_t stamp = 0;
+};
+
+#endif // __CaptureDedupe_h__
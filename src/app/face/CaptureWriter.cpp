@@ -0,0 +1,546 @@
+/*!
+  @file   CaptureWriter.cpp
+  @author David Hirvonen
+  @brief  Asynchronous batched file output for encoded captures.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "CaptureWriter.h"
+#include "FrameTrace.h"
+#include "PerfReport.h"
+#include "PipelineStats.h"
+#include "ThreadTopology.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+// clang-format off
+#if defined(__unix__) || defined(__APPLE__)
+#  define DRISHTI_SDK_TEST_HAVE_PWRITE 1
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#  include <sys/uio.h>
+#  include <unistd.h>
+#endif
+#if defined(DRISHTI_SDK_TEST_HAVE_LIBURING)
+#  include <liburing.h>
+#endif
+// clang-format on
+
+// O_DIRECT transfers must be aligned (address, length and offset):
+static const std::size_t kDirectAlignment = 4096;
+
+// clang-format off
+namespace detail
+{
+    template <typename Value, typename... Arguments>
+    std::unique_ptr<Value> make_unique(Arguments&&... arguments_for_constructor)
+    {
+        return std::unique_ptr<Value>(new Value(std::forward<Arguments>(arguments_for_constructor)...));
+    }
+}
+// clang-format on
+
+struct CaptureWriter::Impl
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Job
+    {
+        ~Job()
+        {
+            std::free(aligned);
+        }
+
+        const std::uint8_t* data() const { return aligned ? aligned : buffer.data(); }
+
+        std::string filename;
+        std::vector<std::uint8_t> buffer; // encoded file
+        std::uint8_t* aligned = nullptr;  // padded O_DIRECT copy
+        std::size_t length = 0;           // bytes to write (padded for O_DIRECT)
+        std::size_t offset = 0;           // bytes written
+        int fd = -1;
+        bool ok = false; // io_uring completion status
+        Clock::time_point queued;
+#if defined(DRISHTI_SDK_TEST_HAVE_PWRITE)
+        iovec vector; // io_uring writev() argument
+#endif
+    };
+
+    Impl(std::shared_ptr<spdlog::logger>& logger, const Settings& settings)
+        : logger(logger)
+        , settings(settings)
+    {
+#if !defined(O_DIRECT)
+        if (this->settings.direct)
+        {
+            logger->warn("CaptureWriter: O_DIRECT is not supported on this platform");
+            this->settings.direct = false;
+        }
+#endif
+
+#if defined(DRISHTI_SDK_TEST_HAVE_LIBURING)
+        if (settings.backend != Backend::kThreads)
+        {
+            const auto depth = static_cast<unsigned>(std::max(settings.depth, std::size_t(1)));
+            const int status = io_uring_queue_init(depth, &ring, 0);
+            if (status == 0)
+            {
+                // open(), ftruncate() and close() block, so they run on the
+                // helper pool and the ring thread only submits writes:
+                hasRing = true;
+                workers.emplace_back([this]() { loopUring(); });
+                for (std::size_t i = 0; i < std::max(settings.threads, std::size_t(1)); i++)
+                {
+                    workers.emplace_back([this]() { loopHelper(); });
+                }
+                return;
+            }
+            logger->warn("CaptureWriter: io_uring is not available ({}), using the pwrite thread pool", std::strerror(-status));
+        }
+#else
+        if (settings.backend == Backend::kUring)
+        {
+            logger->warn("CaptureWriter: built without liburing, using the pwrite thread pool");
+        }
+#endif
+
+        for (std::size_t i = 0; i < std::max(settings.threads, std::size_t(1)); i++)
+        {
+            workers.emplace_back([this]() { loopThreads(); });
+        }
+    }
+
+    ~Impl()
+    {
+        flush(); // the stages hand jobs to each other, so stop them once idle
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        cv.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+#if defined(DRISHTI_SDK_TEST_HAVE_LIBURING)
+        if (hasRing)
+        {
+            io_uring_queue_exit(&ring);
+        }
+#endif
+    }
+
+    void write(const std::string& filename, std::vector<std::uint8_t>&& buffer)
+    {
+        auto job = detail::make_unique<Job>();
+        job->filename = filename;
+        job->buffer = std::move(buffer);
+        job->length = job->buffer.size();
+        job->queued = Clock::now();
+
+        // Bound the queued data (the capture worker waits for the disk):
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [this] { return pending < capacity; });
+
+        PipelineStats::get().addInFlight(job->buffer.size());
+        if (pending++ == 0)
+        {
+            busyStart = job->queued;
+        }
+        queue.push_back(std::move(job));
+        lock.unlock();
+        cv.notify_all();
+    }
+
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [this] { return pending == 0; });
+    }
+
+    // Pop up to count jobs (waits for work unless there are writes in flight):
+    bool pop(std::deque<std::unique_ptr<Job>>& source, std::vector<std::unique_ptr<Job>>& jobs, std::size_t count, bool doWait)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (doWait)
+        {
+            cv.wait(lock, [&] { return !source.empty() || !running; });
+        }
+
+        while (!source.empty() && (jobs.size() < count))
+        {
+            jobs.push_back(std::move(source.front()));
+            source.pop_front();
+        }
+        return !jobs.empty() || running;
+    }
+
+    void push(std::deque<std::unique_ptr<Job>>& target, std::unique_ptr<Job>&& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            target.push_back(std::move(job));
+        }
+        cv.notify_all();
+    }
+
+#if defined(DRISHTI_SDK_TEST_HAVE_PWRITE)
+    bool open(Job& job)
+    {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#if defined(O_DIRECT)
+        if (settings.direct)
+        {
+            // Pad the copy to the alignment, the file is truncated after the write:
+            const std::size_t length = ((job.buffer.size() + kDirectAlignment - 1) / kDirectAlignment) * kDirectAlignment;
+            void* ptr = nullptr;
+            if ((length > 0) && (::posix_memalign(&ptr, kDirectAlignment, length) == 0))
+            {
+                job.aligned = static_cast<std::uint8_t*>(ptr);
+                std::copy(job.buffer.begin(), job.buffer.end(), job.aligned);
+                std::fill(job.aligned + job.buffer.size(), job.aligned + length, std::uint8_t(0));
+                job.length = length;
+                flags |= O_DIRECT;
+            }
+        }
+#endif
+
+        job.fd = ::open(job.filename.c_str(), flags, 0644);
+
+#if defined(O_DIRECT)
+        if ((job.fd < 0) && (errno == EINVAL) && (flags & O_DIRECT))
+        {
+            // i.e., tmpfs doesn't support O_DIRECT:
+            if (!directFailed.exchange(true))
+            {
+                logger->warn("CaptureWriter: O_DIRECT is not supported for {}, using buffered writes", job.filename);
+            }
+            job.length = job.buffer.size();
+            job.fd = ::open(job.filename.c_str(), flags & ~O_DIRECT, 0644);
+        }
+#endif
+
+        return job.fd >= 0;
+    }
+
+    void loopThreads()
+    {
+        FrameTrace::get().setThreadName("writer");
+        ThreadTopology::get().apply("writer");
+
+        std::vector<std::unique_ptr<Job>> jobs;
+        while (pop(queue, jobs, 1, true))
+        {
+            for (auto& job : jobs)
+            {
+                bool ok = open(*job);
+                while (ok && (job->offset < job->length))
+                {
+                    const auto count = ::pwrite(job->fd, job->data() + job->offset, job->length - job->offset, job->offset);
+                    if ((count < 0) && (errno == EINTR))
+                    {
+                        continue;
+                    }
+                    ok = (count > 0);
+                    job->offset += ok ? static_cast<std::size_t>(count) : 0;
+                }
+                finish(*job, ok);
+            }
+            jobs.clear();
+        }
+    }
+#else
+    // Portable blocking fallback:
+    void loopThreads()
+    {
+        std::vector<std::unique_ptr<Job>> jobs;
+        while (pop(queue, jobs, 1, true))
+        {
+            for (auto& job : jobs)
+            {
+                std::ofstream ofs(job->filename, std::ios::binary);
+                finish(*job, static_cast<bool>(ofs.write(reinterpret_cast<const char*>(job->data()), job->length)));
+            }
+            jobs.clear();
+        }
+    }
+#endif
+
+#if defined(DRISHTI_SDK_TEST_HAVE_LIBURING)
+    bool submit(Job* job)
+    {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (!sqe)
+        {
+            return false;
+        }
+
+        // writev() is supported by all io_uring kernels (5.1+):
+        job->vector.iov_base = const_cast<std::uint8_t*>(job->data() + job->offset);
+        job->vector.iov_len = job->length - job->offset;
+        io_uring_prep_writev(sqe, job->fd, &job->vector, 1, job->offset);
+        io_uring_sqe_set_data(sqe, job);
+        return true;
+    }
+
+    // Open new files and close completed ones (ring mode), closes go first
+    // since they release in-flight memory:
+    void loopHelper()
+    {
+        FrameTrace::get().setThreadName("writer");
+        ThreadTopology::get().apply("writer");
+
+        while (true)
+        {
+            std::unique_ptr<Job> job;
+            bool isCompleted = false;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return !completed.empty() || !queue.empty() || !running; });
+                auto& source = completed.empty() ? queue : completed;
+                if (source.empty())
+                {
+                    break; // stopped (the destructor waits for the writes first)
+                }
+                isCompleted = (&source == &completed);
+                job = std::move(source.front());
+                source.pop_front();
+            }
+
+            if (isCompleted)
+            {
+                finish(*job, job->ok);
+            }
+            else if (!open(*job))
+            {
+                finish(*job, false);
+            }
+            else
+            {
+                push(opened, std::move(job));
+            }
+        }
+    }
+
+    void loopUring()
+    {
+        FrameTrace::get().setThreadName("writer");
+        ThreadTopology::get().apply("writer");
+
+        const std::size_t depth = std::max(settings.depth, std::size_t(1));
+        std::size_t inflight = 0;
+
+        std::vector<std::unique_ptr<Job>> jobs;
+        while (pop(opened, jobs, depth - inflight, inflight == 0) || inflight)
+        {
+            // Submit the batch with a single system call:
+            std::size_t submitted = 0;
+            for (auto& job : jobs)
+            {
+                if (!submit(job.get()))
+                {
+                    job->ok = false;
+                    push(completed, std::move(job));
+                    continue;
+                }
+                job.release(); // owned by the ring until completion
+                submitted++;
+            }
+            jobs.clear();
+
+            if (submitted)
+            {
+                io_uring_submit(&ring);
+                inflight += submitted;
+            }
+
+            if (inflight == 0)
+            {
+                continue;
+            }
+
+            // Block for a completion when the ring is full or there is no new work:
+            io_uring_cqe* cqe = nullptr;
+            bool isIdle = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                isIdle = opened.empty();
+            }
+            if ((inflight == depth) || isIdle)
+            {
+                if (io_uring_wait_cqe(&ring, &cqe) < 0)
+                {
+                    continue;
+                }
+            }
+
+            std::size_t resubmitted = 0;
+            while ((io_uring_peek_cqe(&ring, &cqe) == 0) && cqe)
+            {
+                std::unique_ptr<Job> job(static_cast<Job*>(io_uring_cqe_get_data(cqe)));
+                const int result = cqe->res;
+                io_uring_cqe_seen(&ring, cqe);
+                inflight--;
+
+                if (result > 0)
+                {
+                    job->offset += static_cast<std::size_t>(result);
+                    if ((job->offset < job->length) && submit(job.get()))
+                    {
+                        job.release(); // short write: submit the remainder
+                        inflight++;
+                        resubmitted++;
+                        continue;
+                    }
+                }
+                job->ok = (result > 0) && (job->offset >= job->length);
+                push(completed, std::move(job));
+            }
+
+            if (resubmitted)
+            {
+                io_uring_submit(&ring);
+            }
+        }
+    }
+
+    io_uring ring;
+    bool hasRing = false;
+#endif
+
+    void finish(Job& job, bool ok)
+    {
+#if defined(DRISHTI_SDK_TEST_HAVE_PWRITE)
+        if (job.fd >= 0)
+        {
+            if (ok && (job.length != job.buffer.size()))
+            {
+                ok = (::ftruncate(job.fd, static_cast<off_t>(job.buffer.size())) == 0); // O_DIRECT padding
+            }
+            ::close(job.fd);
+            job.fd = -1;
+        }
+#endif
+
+        const auto now = Clock::now();
+        const double latency = std::chrono::duration<double>(now - job.queued).count();
+
+        auto& stats = PipelineStats::get();
+        stats.removeInFlight(job.buffer.size());
+        stats.writeLatency.add(static_cast<std::uint64_t>(latency * 1e6));
+        if (ok)
+        {
+            stats.bytesWritten += job.buffer.size();
+        }
+        else
+        {
+            logger->error("CaptureWriter: failed to write {}", job.filename);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            (ok ? files : failures)++;
+            bytes += ok ? job.buffer.size() : 0;
+            latencies.add(latency);
+
+            // Bandwidth is measured over the intervals with pending writes:
+            if (--pending == 0)
+            {
+                busy += std::chrono::duration<double>(now - busyStart).count();
+            }
+        }
+        drained.notify_all();
+    }
+
+    std::shared_ptr<spdlog::logger> logger;
+    Settings settings;
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable cv;      // jobs are available
+    std::condition_variable drained; // a job finished
+    std::deque<std::unique_ptr<Job>> queue;
+    std::deque<std::unique_ptr<Job>> opened;    // ring mode: ready to submit
+    std::deque<std::unique_ptr<Job>> completed; // ring mode: ready to close
+    std::size_t pending = 0; // queued + in flight
+    std::size_t capacity = std::max(settings.queue, std::size_t(1));
+    bool running = true;
+    std::atomic<bool> directFailed{ false };
+
+    // Statistics (guarded by mutex):
+    std::size_t files = 0;
+    std::size_t failures = 0;
+    std::uint64_t bytes = 0;
+    double busy = 0.0; // seconds with pending writes
+    Clock::time_point busyStart;
+    PerfReport latencies; // completion latency (seconds)
+};
+
+CaptureWriter::CaptureWriter(std::shared_ptr<spdlog::logger>& logger, const Settings& settings)
+{
+    m_impl = detail::make_unique<Impl>(logger, settings);
+}
+
+CaptureWriter::~CaptureWriter() = default;
+
+void CaptureWriter::write(const std::string& filename, std::vector<std::uint8_t>&& buffer)
+{
+    m_impl->write(filename, std::move(buffer));
+}
+
+void CaptureWriter::flush()
+{
+    m_impl->flush();
+}
+
+const char* CaptureWriter::getBackend() const
+{
+#if defined(DRISHTI_SDK_TEST_HAVE_LIBURING)
+    if (m_impl->hasRing)
+    {
+        return "uring";
+    }
+#endif
+    return "threads";
+}
+
+void CaptureWriter::report(spdlog::logger& logger) const
+{
+    PerfReport latencies;
+    std::size_t files = 0, failures = 0;
+    std::uint64_t bytes = 0;
+    double busy = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(m_impl->mutex);
+        latencies = m_impl->latencies;
+        files = m_impl->files;
+        failures = m_impl->failures;
+        bytes = m_impl->bytes;
+        busy = m_impl->busy;
+    }
+
+    const double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+    const double bandwidth = (busy > 0.0) ? (megabytes / busy) : 0.0;
+    logger.info("Writer ({}): {} files, {} MB in {} seconds busy ({} MB/s), {} failures", getBackend(), files, megabytes, busy, bandwidth, failures);
+
+    if (files + failures)
+    {
+        const auto percentile = [&](double p) { return latencies.getPercentile(p) * 1e3; };
+        logger.info("Writer completion latency (ms): p50 {} p90 {} p99 {} max {}", percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+    }
+}
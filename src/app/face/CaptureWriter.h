@@ -0,0 +1,72 @@
+/*!
+  @file   CaptureWriter.h
+  @author David Hirvonen
+  @brief  Asynchronous batched file output for encoded captures.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  Encoded buffers are queued and written in the background, so a slow disk
+  (or network mount) doesn't stall the capture worker:
+
+  - uring: a single thread submits batches of writes through io_uring with
+    up to <depth> writes in flight (requires liburing at build time), the
+    blocking open() and close() calls run on a small helper pool.
+  - threads: a pool of threads with blocking pwrite() calls (the fallback).
+
+  With O_DIRECT the buffers are copied into aligned (padded) memory and the
+  files are truncated to their real size after the write.  Queued bytes are
+  counted as in-flight capture data (see FaceTrackTest::setCaptureBudget())
+  and write() blocks while <queue> files are pending.
+
+*/
+
+#ifndef __CaptureWriter_h__
+#define __CaptureWriter_h__
+
+#include <spdlog/spdlog.h> // for portable logging
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class CaptureWriter
+{
+public:
+    enum class Backend
+    {
+        kAuto,   // io_uring when available, else threads
+        kUring,  // io_uring (falls back to threads if the ring can't be created)
+        kThreads // pwrite() thread pool
+    };
+
+    struct Settings
+    {
+        Backend backend = Backend::kAuto;
+        std::size_t depth = 32;  // max io_uring writes in flight
+        std::size_t threads = 2; // pwrite() pool size (open/close helpers with io_uring)
+        std::size_t queue = 256; // max queued + in flight files (write() blocks)
+        bool direct = false;     // O_DIRECT (bypass the page cache)
+    };
+
+    CaptureWriter(std::shared_ptr<spdlog::logger>& logger, const Settings& settings);
+    ~CaptureWriter(); // complete all queued writes
+
+    // Queue an encoded buffer (ownership is transferred), blocks while the queue is full:
+    void write(const std::string& filename, std::vector<std::uint8_t>&& buffer);
+
+    // Wait for all queued writes to complete:
+    void flush();
+
+    const char* getBackend() const; // "uring" or "threads"
+
+    // Log the bandwidth, completion latency percentiles and failures:
+    void report(spdlog::logger& logger) const;
+
+protected:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+#endif // __CaptureWriter_h__
@@ -0,0 +1,309 @@
+/*!
+  @file   ControlServer.cpp
+  @author David Hirvonen
+  @brief  Local (Unix domain socket) control server with a simple line protocol.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "ControlServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <thread>
+
+// clang-format off
+#if defined(__unix__) || defined(__APPLE__)
+#  define DRISHTI_SDK_TEST_HAVE_UNIX_SOCKETS 1
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+// clang-format on
+
+// Don't raise SIGPIPE when a client disconnects mid response:
+#if defined(MSG_NOSIGNAL)
+static const int kSendFlags = MSG_NOSIGNAL;
+#else
+static const int kSendFlags = 0;
+#endif
+
+// clang-format off
+namespace detail
+{
+    template <typename Value, typename... Arguments>
+    std::unique_ptr<Value> make_unique(Arguments&&... arguments_for_constructor)
+    {
+        return std::unique_ptr<Value>(new Value(std::forward<Arguments>(arguments_for_constructor)...));
+    }
+}
+// clang-format on
+
+struct ControlServer::Impl
+{
+    struct Command
+    {
+        std::string usage;
+        Handler handler;
+    };
+
+    struct Client
+    {
+        int fd;
+        std::string buffer;
+    };
+
+    Impl(std::shared_ptr<spdlog::logger>& logger)
+        : logger(logger)
+    {
+    }
+
+    ~Impl()
+    {
+        stop();
+    }
+
+    std::string execute(const std::string& line)
+    {
+        std::istringstream iss(line);
+        Arguments args{ std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>() };
+
+        std::stringstream ss;
+        if (args.empty())
+        {
+            return "ok\n";
+        }
+
+        const auto name = args.front();
+        args.erase(args.begin());
+
+        if (name == "help")
+        {
+            for (const auto& command : commands)
+            {
+                ss << command.first << " " << command.second.usage << "\n";
+            }
+            ss << "ok\n";
+            return ss.str();
+        }
+
+        auto iter = commands.find(name);
+        if (iter == commands.end())
+        {
+            return "error: unknown command " + name + " (try help)\n";
+        }
+
+        try
+        {
+            iter->second.handler(args, ss);
+            ss << "ok\n";
+        }
+        catch (const std::exception& e)
+        {
+            ss << "error: " << e.what() << "\n";
+        }
+        return ss.str();
+    }
+
+#if defined(DRISHTI_SDK_TEST_HAVE_UNIX_SOCKETS)
+    bool start(const std::string& filename)
+    {
+        sockaddr_un address{};
+        if (filename.size() >= sizeof(address.sun_path))
+        {
+            logger->error("Control socket path is too long: {}", filename);
+            return false;
+        }
+
+        address.sun_family = AF_UNIX;
+        std::copy(filename.begin(), filename.end(), address.sun_path);
+
+        listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0)
+        {
+            logger->error("Failed to create control socket");
+            return false;
+        }
+
+        ::unlink(filename.c_str()); // remove stale socket from a previous run
+        if ((::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) || (::listen(listener, 4) != 0))
+        {
+            logger->error("Failed to bind control socket {}", filename);
+            ::close(listener);
+            listener = -1;
+            return false;
+        }
+
+        path = filename;
+        running = true;
+        thread = std::thread([this] { loop(); });
+        logger->info("Listening for control commands on {}", path);
+        return true;
+    }
+
+    void stop()
+    {
+        running = false;
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+
+        for (auto& client : clients)
+        {
+            ::close(client.fd);
+        }
+        clients.clear();
+
+        if (listener >= 0)
+        {
+            ::close(listener);
+            ::unlink(path.c_str());
+            listener = -1;
+        }
+    }
+
+    void loop()
+    {
+        while (running)
+        {
+            std::vector<pollfd> fds{ { listener, POLLIN, 0 } };
+            for (const auto& client : clients)
+            {
+                fds.push_back({ client.fd, POLLIN, 0 });
+            }
+
+            // Use a short timeout so that stop() is handled promptly:
+            if (::poll(fds.data(), fds.size(), 100) <= 0)
+            {
+                continue;
+            }
+
+            // Service existing clients first (indices are stable until we erase):
+            for (std::size_t i = fds.size() - 1; i > 0; i--)
+            {
+                if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                {
+                    if (!read(clients[i - 1]))
+                    {
+                        ::close(clients[i - 1].fd);
+                        clients.erase(clients.begin() + (i - 1));
+                    }
+                }
+            }
+
+            if (fds[0].revents & POLLIN)
+            {
+                const int fd = ::accept(listener, nullptr, nullptr);
+                if (fd >= 0)
+                {
+                    clients.push_back({ fd, {} });
+                }
+            }
+        }
+    }
+
+    // Read available data and answer any complete lines:
+    bool read(Client& client)
+    {
+        char data[1024];
+        const auto count = ::recv(client.fd, data, sizeof(data), 0);
+        if (count <= 0)
+        {
+            return false;
+        }
+
+        client.buffer.append(data, static_cast<std::size_t>(count));
+
+        std::size_t end = 0;
+        while ((end = client.buffer.find('\n')) != std::string::npos)
+        {
+            std::string line = client.buffer.substr(0, end);
+            client.buffer.erase(0, end + 1);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            if (line == "quit")
+            {
+                return false;
+            }
+
+            const auto response = execute(line);
+            if (!write(client.fd, response))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static bool write(int fd, const std::string& response)
+    {
+        std::size_t offset = 0;
+        while (offset < response.size())
+        {
+            const auto count = ::send(fd, response.data() + offset, response.size() - offset, kSendFlags);
+            if (count <= 0)
+            {
+                return false;
+            }
+            offset += static_cast<std::size_t>(count);
+        }
+        return true;
+    }
+
+    int listener = -1;
+    std::vector<Client> clients;
+#else
+    bool start(const std::string& filename)
+    {
+        logger->error("Control sockets are not supported on this platform");
+        return false;
+    }
+
+    void stop() {}
+#endif
+
+    std::shared_ptr<spdlog::logger> logger;
+    std::map<std::string, Command> commands;
+
+    std::string path;
+    std::atomic<bool> running{ false };
+    std::thread thread;
+};
+
+ControlServer::ControlServer(std::shared_ptr<spdlog::logger>& logger)
+{
+    m_impl = detail::make_unique<Impl>(logger);
+}
+
+ControlServer::~ControlServer() = default;
+
+void ControlServer::add(const std::string& command, const std::string& usage, const Handler& handler)
+{
+    m_impl->commands[command] = { usage, handler };
+}
+
+bool ControlServer::start(const std::string& path)
+{
+    return m_impl->start(path);
+}
+
+void ControlServer::stop()
+{
+    m_impl->stop();
+}
+
+std::string ControlServer::execute(const std::string& line)
+{
+    return m_impl->execute(line);
+}
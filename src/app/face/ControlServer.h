@@ -0,0 +1,104 @@
+/*!
+  @file   ControlServer.h
+  @author David Hirvonen
+  @brief  Local (Unix domain socket) control server with a simple line protocol.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  Each request is a single line of whitespace separated tokens:
+
+    <command> [arg1 [arg2 ...]]
+
+  The response is zero or more data lines followed by a status line, which is
+  either "ok" or "error: <message>".  A session can be opened with:
+
+    socat - UNIX-CONNECT:/tmp/drishti-face-test.sock
+
+*/
+
+#ifndef __ControlServer_h__
+#define __ControlServer_h__
+
+#include <spdlog/spdlog.h> // for portable logging
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class ControlServer
+{
+public:
+    using Arguments = std::vector<std::string>;
+
+    // Write response data to the stream, throw std::runtime_error on failure:
+    using Handler = std::function<void(const Arguments& args, std::ostream& os)>;
+
+    ControlServer(std::shared_ptr<spdlog::logger>& logger);
+    ~ControlServer();
+
+    void add(const std::string& command, const std::string& usage, const Handler& handler);
+
+    // Listen on the specified socket path (from a dedicated thread):
+    bool start(const std::string& path);
+    void stop();
+
+    // Parse and run a single request line, return the full response:
+    std::string execute(const std::string& line);
+
+protected:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+// Run tasks posted from other threads (i.e., the control server) on the
+// thread that calls poll() (i.e., the OpenGL/tracker thread), so that runtime
+// changes never race with the frame loop.
+class TaskQueue
+{
+public:
+    using Task = std::function<std::string()>;
+
+    // Wait for the task to complete, the task must capture state by value
+    // since it will still run after a timeout.
+    std::string call(const Task& task, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+    {
+        auto job = std::make_shared<std::packaged_task<std::string()>>(task);
+        auto result = job->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(job);
+        }
+
+        if (result.wait_for(timeout) != std::future_status::ready)
+        {
+            throw std::runtime_error("timeout waiting for the frame loop");
+        }
+        return result.get();
+    }
+
+    void poll()
+    {
+        std::vector<std::shared_ptr<std::packaged_task<std::string()>>> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.swap(tasks);
+        }
+
+        for (auto& job : pending)
+        {
+            (*job)();
+        }
+    }
+
+protected:
+    std::mutex mutex;
+    std::vector<std::shared_ptr<std::packaged_task<std::string()>>> tasks;
+};
+
+#endif // __ControlServer_h__
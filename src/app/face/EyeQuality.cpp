@@ -0,0 +1,107 @@
+/*!
+  @file   EyeQuality.cpp
+  @author David Hirvonen
+  @brief  Image quality scores for captured eye crops.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "EyeQuality.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <nlohmann/json.hpp> // nlohman-json
+
+#include <algorithm>
+#include <cmath>
+
+// Laplacian variance that maps to a sharpness of 0.5:
+static const double kSharpnessScale = 100.0;
+
+// Gray levels counted as clipped (crushed or saturated):
+static const int kClipLow = 8;
+static const int kClipHigh = 247;
+
+static float getVisibility(const FrameResult::Eye& eye)
+{
+    const auto& iris = eye.iris;
+    const double area = CV_PI * 0.25 * iris.size.width * iris.size.height;
+    if ((eye.eyelids.size() < 3) || (area <= 0.0))
+    {
+        return 1.f;
+    }
+
+    std::vector<cv::Point> ellipse;
+    const cv::Point center(cvRound(iris.center.x), cvRound(iris.center.y));
+    const cv::Size axes(cvRound(iris.size.width * 0.5f), cvRound(iris.size.height * 0.5f));
+    cv::ellipse2Poly(center, axes, cvRound(iris.angle), 0, 360, 10, ellipse);
+
+    std::vector<cv::Point2f> iris2f(ellipse.begin(), ellipse.end()), eyelids, overlap;
+    cv::convexHull(eye.eyelids, eyelids);
+    const float visible = cv::intersectConvexConvex(iris2f, eyelids, overlap);
+    return static_cast<float>(std::min(std::max(visible / area, 0.0), 1.0));
+}
+
+EyeQuality::EyeQuality(const cv::Mat& eyes, const std::vector<FrameResult::Eye>& models)
+{
+    if (eyes.empty())
+    {
+        return;
+    }
+
+    cv::Mat gray;
+    switch (eyes.channels())
+    {
+        case 3:
+            cv::cvtColor(eyes, gray, cv::COLOR_BGR2GRAY);
+            break;
+        case 4:
+            cv::cvtColor(eyes, gray, cv::COLOR_BGRA2GRAY);
+            break;
+        default:
+            gray = eyes;
+            break;
+    }
+
+    { // Sharpness:
+        cv::Mat edges;
+        cv::Scalar mu, sigma;
+        cv::Laplacian(gray, edges, CV_16S);
+        cv::meanStdDev(edges, mu, sigma);
+        laplacian = sigma[0] * sigma[0];
+        sharpness = static_cast<float>(laplacian / (laplacian + kSharpnessScale));
+    }
+
+    { // Exposure:
+        const double mean = cv::mean(gray)[0] / 255.0;
+        const int clipped = cv::countNonZero(gray < kClipLow) + cv::countNonZero(gray > kClipHigh);
+        const double fraction = static_cast<double>(clipped) / static_cast<double>(gray.total());
+        exposure = static_cast<float>(std::max(1.0 - 2.0 * std::abs(mean - 0.5) - fraction, 0.0));
+    }
+
+    if (!models.empty())
+    { // Iris visibility (mean over both eyes):
+        float total = 0.f;
+        for (const auto& e : models)
+        {
+            total += getVisibility(e);
+        }
+        visibility = total / static_cast<float>(models.size());
+    }
+
+    score = std::min(std::min(sharpness, exposure), visibility);
+}
+
+std::string EyeQuality::toJson() const
+{
+    nlohmann::json json = {
+        { "score", score },
+        { "sharpness", sharpness },
+        { "laplacian", laplacian },
+        { "exposure", exposure },
+        { "visibility", visibility }
+    };
+    return json.dump();
+}
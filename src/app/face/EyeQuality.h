@@ -0,0 +1,41 @@
+/*!
+  @file   EyeQuality.h
+  @author David Hirvonen
+  @brief  Image quality scores for captured eye crops.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  Each term is normalized to [0,1] and the crop score is the weakest term:
+
+  - sharpness: variance of the Laplacian (blur removes high frequencies)
+  - exposure: distance of the mean from mid-gray, less the clipped fraction
+  - visibility: fraction of the iris ellipse inside the eyelid contour
+
+*/
+
+#ifndef __EyeQuality_h__
+#define __EyeQuality_h__
+
+#include "FrameResult.h"
+
+#include <opencv2/core.hpp>
+
+#include <string>
+#include <vector>
+
+struct EyeQuality
+{
+    EyeQuality() = default;
+    EyeQuality(const cv::Mat& eyes, const std::vector<FrameResult::Eye>& models);
+
+    double laplacian = 0.0; // raw Laplacian variance
+    float sharpness = 0.f;
+    float exposure = 0.f;
+    float visibility = 1.f; // 1 if there are no eye models
+    float score = 0.f;
+
+    std::string toJson() const;
+};
+
+#endif // __EyeQuality_h__
@@ -0,0 +1,207 @@
+/*!
+  @file   EyeRefiner.cpp
+  @author David Hirvonen
+  @brief  Refine captured eye crops with a pool of EyeSegmenter workers.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "EyeRefiner.h"
+#include "EyeSegment.h"
+#include "FrameTrace.h"
+#include "PipelineStage.h"
+#include "PipelineStats.h"
+#include "ThreadTopology.h"
+
+#include <drishti/EyeSegmenter.hpp>
+
+#include <opencv2/highgui.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// clang-format off
+namespace detail
+{
+    template <typename Value, typename... Arguments>
+    std::unique_ptr<Value> make_unique(Arguments&&... arguments_for_constructor)
+    {
+        return std::unique_ptr<Value>(new Value(std::forward<Arguments>(arguments_for_constructor)...));
+    }
+}
+// clang-format on
+
+struct EyeRefiner::Impl
+{
+    struct Job
+    {
+        cv::Mat eyes;
+        std::string prefix;
+        std::uint64_t frame;
+    };
+
+    Impl(std::shared_ptr<spdlog::logger>& logger, const std::string& model, std::size_t threads, std::size_t capacity, int width)
+        : logger(logger)
+        , workingWidth(width)
+        , capacity(capacity)
+    {
+        // Load all segmenters up front so that model errors are reported here:
+        for (std::size_t i = 0; i < std::max(threads, std::size_t(1)); i++)
+        {
+            auto segmenter = std::make_shared<drishti::sdk::EyeSegmenter>(model);
+            if (!(*segmenter))
+            {
+                throw std::runtime_error("EyeRefiner: unable to load eye model " + model);
+            }
+            segmenters.push_back(segmenter);
+        }
+
+        for (auto& segmenter : segmenters)
+        {
+            workers.emplace_back([this, segmenter]() { loop(*segmenter); });
+        }
+    }
+
+    ~Impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        cv.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    bool post(const cv::Mat& eyes, const std::string& prefix)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.size() >= capacity)
+            {
+                dropped++;
+                return false;
+            }
+            queue.push_back({ eyes, prefix, FrameTrace::getFrame() });
+            pending++;
+        }
+        cv.notify_one();
+        return true;
+    }
+
+    void loop(drishti::sdk::EyeSegmenter& segmenter)
+    {
+        FrameTrace::get().setThreadName("refine");
+        ThreadTopology::get().apply("refine");
+
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return !queue.empty() || !running; });
+                if (queue.empty())
+                {
+                    break; // stopped and drained
+                }
+
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            FrameTrace::setFrame(job.frame);
+            {
+                ScopedStage stage(PipelineStage::kRefine);
+                refine(segmenter, job);
+            }
+            pending--;
+        }
+    }
+
+    void refine(drishti::sdk::EyeSegmenter& segmenter, const Job& job)
+    {
+        const int width = job.eyes.cols / 2;
+        if ((width == 0) || (job.eyes.rows == 0))
+        {
+            return;
+        }
+
+        const std::pair<bool, const char*> sides[] = { { true, "_right" }, { false, "_left" } };
+        for (const auto& side : sides)
+        {
+            const cv::Mat crop = job.eyes(cv::Rect(side.first ? 0 : width, 0, width, job.eyes.rows));
+
+            drishti::sdk::Eye eye;
+            cv::Mat1b mask;
+            const std::string name = job.prefix + side.second;
+            if (!segment(segmenter, crop, side.first, eye, mask, workingWidth))
+            {
+                logger->error("EyeRefiner: unable to segment {}", name);
+                continue;
+            }
+
+            if (!cv::imwrite(name + "_mask.png", mask))
+            {
+                logger->error("EyeRefiner: unable to write {}_mask.png", name);
+            }
+
+            std::ofstream ofs(name + ".json");
+            if (ofs)
+            {
+                ofs << toJson(eye);
+            }
+            else
+            {
+                logger->error("EyeRefiner: unable to write {}.json", name);
+            }
+        }
+    }
+
+    std::shared_ptr<spdlog::logger> logger;
+    int workingWidth = 0; // segment wider eye crops at this width (0 == native)
+    std::vector<std::shared_ptr<drishti::sdk::EyeSegmenter>> segmenters;
+    std::vector<std::thread> workers;
+
+    std::size_t capacity;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Job> queue;
+    bool running = true;
+
+    std::atomic<std::size_t> pending{ 0 };
+    std::atomic<std::size_t> dropped{ 0 };
+};
+
+EyeRefiner::EyeRefiner(std::shared_ptr<spdlog::logger>& logger, const std::string& model, std::size_t threads, std::size_t capacity, int width)
+{
+    m_impl = detail::make_unique<Impl>(logger, model, threads, capacity, width);
+}
+
+EyeRefiner::~EyeRefiner() = default;
+
+bool EyeRefiner::post(const cv::Mat& eyes, const std::string& prefix)
+{
+    return m_impl->post(eyes, prefix);
+}
+
+std::size_t EyeRefiner::depth() const
+{
+    return m_impl->pending;
+}
+
+std::size_t EyeRefiner::dropped() const
+{
+    return m_impl->dropped;
+}
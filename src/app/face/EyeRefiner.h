@@ -0,0 +1,45 @@
+/*!
+  @file   EyeRefiner.h
+  @author David Hirvonen
+  @brief  Refine captured eye crops with a pool of EyeSegmenter workers.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#ifndef __EyeRefiner_h__
+#define __EyeRefiner_h__
+
+#include <opencv2/core.hpp>
+
+#include <spdlog/spdlog.h> // for portable logging
+
+#include <memory>
+#include <string>
+
+// The face tracker eye crop holds both eyes side by side (the subject's right
+// eye is on the left).  Each worker thread owns an EyeSegmenter and writes the
+// refined eye models (JSON) and masks next to the capture:
+//
+//   <prefix>_right.json, <prefix>_right_mask.png
+//   <prefix>_left.json, <prefix>_left_mask.png
+class EyeRefiner
+{
+public:
+    // Eye crops wider than width (> 0) are segmented at that width (see EyeSegment.h):
+    EyeRefiner(std::shared_ptr<spdlog::logger>& logger, const std::string& model, std::size_t threads, std::size_t capacity, int width = 0);
+    ~EyeRefiner(); // process all queued jobs, then join
+
+    // Queue an eye crop (BGRA, BGR or grayscale), returns false if the queue is full:
+    bool post(const cv::Mat& eyes, const std::string& prefix);
+
+    std::size_t depth() const;   // queued + active jobs
+    std::size_t dropped() const; // jobs rejected by post()
+
+protected:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+#endif // __EyeRefiner_h__
@@ -19,6 +19,9 @@
 
 #include <nlohmann/json.hpp> // nlohman-json
 
+#include <fstream>
+#include <sstream>
+
 #include <boost/filesystem.hpp> // for portable path (de)construction
 
 namespace bfs = boost::filesystem;
@@ -44,20 +47,38 @@ FaceTrackerFactoryJson::FaceTrackerFactoryJson(const std::string& sModels, const
         { "face_detector_mean", &factory.sFaceModel }
     };
 
-    // Get the directory name:
+    // Relative model paths are resolved w.r.t. the JSON file directory:
     auto path = bfs::path(sModels);
     for (auto& binding : bindings)
     {
-        auto filename = path.parent_path() / json[binding.first].get<std::string>();
-        std::shared_ptr<std::istream> stream = std::make_shared<std::ifstream>(filename.string(), std::ios_base::binary | std::ios::in);
-        if (!stream || !stream->good())
+        auto filename = bfs::path(json[binding.first].get<std::string>());
+        if (filename.is_relative())
+        {
+            filename = path.parent_path() / filename;
+        }
+        std::ifstream stream(filename.string(), std::ios_base::binary | std::ios::in);
+        if (!stream.good())
         {
             throw std::runtime_error(cat("FactoryLoader::FactoryLoader() failed to open ", binding.first));
         }
 
-        (*binding.second) = stream.get();
-        streams.push_back(stream);
+        std::stringstream buffer;
+        buffer << stream.rdbuf();
+        models.emplace_back(buffer.str(), binding.second);
     }
 
+    reset();
+
     good = true;
 }
+
+void FaceTrackerFactoryJson::reset()
+{
+    streams.clear();
+    for (auto& model : models)
+    {
+        std::shared_ptr<std::istream> stream = std::make_shared<std::istringstream>(model.first, std::ios_base::binary | std::ios::in);
+        (*model.second) = stream.get();
+        streams.push_back(stream);
+    }
+}
@@ -14,6 +14,8 @@
 #include <drishti/FaceTracker.hpp>
 #include <string>
 #include <memory>
+#include <utility>
+#include <vector>
 
 class FaceTrackerFactoryJson
 {
@@ -21,10 +23,16 @@ public:
     FaceTrackerFactoryJson(const std::string& sModels, const std::string& logger);
     operator bool() const { return good; }
 
+    // Rewind the model streams from the in-memory copies, so that another
+    // tracker can be created (i.e., after a parameter change) without
+    // touching the file system:
+    void reset();
+
     drishti::sdk::FaceTracker::Resources factory;
 
 protected:
     bool good = false;
+    std::vector<std::pair<std::string, std::istream**>> models; // cached model files
     std::vector<std::shared_ptr<std::istream>> streams;
 };
 
@@ -10,14 +10,26 @@
 
 #include "FaceTrackerTest.h"
 #include "AsyncWorker.h"
+#include "CaptureDedupe.h"
+#include "CaptureWriter.h"
+#include "EyeQuality.h"
+#include "PipelineStage.h"
+#include "PipelineStats.h"
+#include "FrameTrace.h"
+#include "MotionGate.h"
+#include "ThreadTopology.h"
 
 #include <ogles_gpgpu/common/proc/disp.h>
 
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
+#include <atomic>
+#include <cmath>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <limits>
 
 // clang-format off
 namespace detail
@@ -32,6 +44,13 @@ namespace detail
 
 static void draw(cv::Mat& image, const drishti::sdk::Eye& eye);
 static void draw(cv::Mat& image, const drishti::sdk::Face& face);
+static std::size_t write(const std::string& filename, const cv::Mat& image, CaptureWriter* writer);
+static std::size_t write(const std::string& filename, const std::string& text, CaptureWriter* writer);
+static cv::Rect getRoi(const drishti_face_tracker_result_t& result, int face, const cv::Size& size, float padding);
+static int getNearestFace(const drishti_face_tracker_result_t& result, const std::array<float, 3>& position);
+
+// Frames retrieved per capture request:
+static const int kCaptureFrames = 3;
 
 struct FaceTrackTest::Impl
 {
@@ -40,6 +59,10 @@ struct FaceTrackTest::Impl
         , output(output)
         , counter(0)
     {
+        worker.init = [] {
+            FrameTrace::get().setThreadName("worker");
+            ThreadTopology::get().apply("writer");
+        };
         worker.start();
     }
 
@@ -69,13 +92,55 @@ struct FaceTrackTest::Impl
     }
     // }
 
+    // Reserve the in-flight bytes of a capture request, so the budget holds
+    // before the readback happens (the crops don't exist yet, so the eye
+    // size is the last one seen by the callback):
+    bool reserve(const drishti_face_tracker_result_t& faces, bool& doFrames)
+    {
+        if (!budget)
+        {
+            return true;
+        }
+
+        // The ROI of the face that triggered the capture (as in the callback):
+        const int face = getNearestFace(faces, capturePosition);
+        const cv::Rect roi = (roiPadding >= 0.f) ? getRoi(faces, face, size, roiPadding) : cv::Rect({ 0, 0 }, size);
+        std::size_t frameBytes = std::size_t(roi.area()) * 4 * kCaptureFrames;
+        const std::size_t eyes = eyeBytes.load(std::memory_order_relaxed) * kCaptureFrames;
+
+        auto& stats = PipelineStats::get();
+        const auto inFlight = stats.bytesInFlight.load(std::memory_order_relaxed);
+        if ((policy != BudgetPolicy::kBackpressure) && ((inFlight + frameBytes + eyes) > budget))
+        {
+            if ((policy == BudgetPolicy::kEyesOnly) && ((inFlight + eyes) <= budget))
+            {
+                logger->warn("trigger: in-flight budget exceeded ({} bytes), requesting eye crops only", inFlight);
+                stats.capturesDegraded++;
+                doFrames = false;
+                frameBytes = 0;
+            }
+            else
+            {
+                logger->warn("trigger: in-flight budget exceeded ({} bytes), skipping capture", inFlight);
+                stats.capturesSkipped++;
+                return false;
+            }
+        }
+
+        stats.addInFlight(frameBytes + eyes);
+        reserved += frameBytes + eyes;
+        return true;
+    }
+
     std::shared_ptr<spdlog::logger> logger;
     std::string output;
     std::size_t counter;
     cv::Size size; // video resolution
+    bool doPreview = true;
 
     // Capture volume {
     std::chrono::high_resolution_clock::time_point captureTimestamp;
+    std::array<float, 3> capturePosition{ { 0.f, 0.f, 0.f } }; // face that triggered the last capture
     double captureInterval = 0.0;
     struct Sphere
     {
@@ -86,6 +151,25 @@ struct FaceTrackTest::Impl
 
     AsyncWorker<std::function<void()>> worker;
 
+    // In-flight capture budget {
+    std::size_t budget = 0; // bytes (0 == unlimited)
+    BudgetPolicy policy = BudgetPolicy::kSkip;
+    std::atomic<std::size_t> reserved{ 0 }; // by trigger() until the callback
+    std::atomic<std::size_t> eyeBytes{ 0 }; // last eye crop size (per result)
+    // }
+
+    ResultHandler resultHandler;
+    EyeHandler eyeHandler;
+    std::shared_ptr<CaptureWriter> writer;
+    std::unique_ptr<CaptureDedupe> dedupe;
+    float eyeQuality = -1.f; // min EyeQuality::score (< 0 == disabled)
+    std::unique_ptr<MotionGate> motion;
+
+    // Face ROI capture {
+    float roiPadding = -1.f; // fraction of the face size (< 0 == full frame)
+    cv::Size roiSize;        // rescale (empty == ROI resolution)
+    // }
+
     // This test class instantiates the ogles_gpgpu::Disp(lay) class in cases
     // where the user has provided a context w/ a visible and active OpenGL window,
     // and the display class will render directly to that screen.  The display
@@ -113,18 +197,97 @@ void FaceTrackTest::setPreviewGeometry(float tx, float ty, float sx, float sy)
     m_impl->setPreviewGeometry(tx, ty, sx, sy);
 }
 
+void FaceTrackTest::setPreviewEnabled(bool value)
+{
+    m_impl->doPreview = value;
+}
+
+bool FaceTrackTest::hasPreview() const
+{
+    return static_cast<bool>(m_impl->display);
+}
+
+void FaceTrackTest::flush()
+{
+    m_impl->worker.flush();
+}
+
+std::size_t FaceTrackTest::getQueueDepth() const
+{
+    return m_impl->worker.depth();
+}
+
 int FaceTrackTest::callback(drishti::sdk::Array<drishti_face_tracker_result_t, 64>& results)
 {
+    ScopedStage stage(PipelineStage::kCallback);
+
     m_impl->logger->info("callback: Received results");
 
     if (results.size() > 0)
     {
+        auto& stats = PipelineStats::get();
+        stats.callbacks++;
+
+        // Trade the bytes reserved by trigger() for the actual copies:
+        const std::size_t reservation = m_impl->reserved.exchange(0);
+        stats.removeInFlight(reservation);
+
+        // Size the copies up front and apply the in-flight budget:
+        std::vector<cv::Rect> rois(results.size());
+        std::vector<int> faces(results.size());
+        std::size_t frameBytes = 0, eyeBytes = 0;
+        for (int i = 0; i < results.size(); i++)
+        {
+            const auto& r = results[i];
+            const cv::Size size(r.image.image.getCols(), r.image.image.getRows());
+            faces[i] = getNearestFace(r, m_impl->capturePosition); // the face that triggered the capture
+            rois[i] = (m_impl->roiPadding >= 0.f) ? getRoi(r, faces[i], size, m_impl->roiPadding) : cv::Rect({ 0, 0 }, size);
+            frameBytes += std::size_t(rois[i].area()) * 4;
+            eyeBytes += std::size_t(r.eyes.image.getRows()) * r.eyes.image.getCols() * 4;
+        }
+
+        if (eyeBytes)
+        {
+            m_impl->eyeBytes.store(eyeBytes / results.size(), std::memory_order_relaxed);
+        }
+
+        // Copies that fit in the reservation are always kept, otherwise the
+        // budget policy applies to the excess:
+        bool doFrames = true;
+        const auto& budget = m_impl->budget;
+        const auto inFlight = stats.bytesInFlight.load(std::memory_order_relaxed);
+        const auto fits = [&](std::size_t bytes) { return (bytes <= reservation) || ((inFlight + bytes) <= budget); };
+        if (budget && (m_impl->policy != BudgetPolicy::kBackpressure) && !fits(frameBytes + eyeBytes))
+        {
+            if ((m_impl->policy == BudgetPolicy::kEyesOnly) && fits(eyeBytes))
+            {
+                m_impl->logger->warn("callback: in-flight budget exceeded ({} bytes), keeping eye crops only", inFlight);
+                stats.capturesDegraded++;
+                doFrames = false;
+                frameBytes = 0;
+            }
+            else
+            {
+                m_impl->logger->warn("callback: in-flight budget exceeded ({} bytes), skipping capture", inFlight);
+                stats.capturesSkipped++;
+                return 0;
+            }
+        }
+
         // Allocate a shared_ptr to store deep copies of the input data, so we can
-        // pass this one around easily to separate worker threads, etc.
-        auto stack = std::make_shared<StackType>(results.size());
+        // pass this one around easily to separate worker threads, etc.  The
+        // copies count against the budget until the last reference is released.
+        const std::size_t bytes = frameBytes + eyeBytes;
+        stats.addInFlight(bytes);
+        std::shared_ptr<StackType> stack(new StackType(results.size()), [bytes](StackType* stack) {
+            delete stack;
+            PipelineStats::get().removeInFlight(bytes);
+        });
+
         for (int i = 0; i < results.size(); i++)
         {
             (*stack)[i].result = results[i];
+            (*stack)[i].face = faces[i];
 
             // IMPORTANT: Here we make a deep copies of the input eye/frame images, since the requested
             // image is passed by a pointer that is only valid for the scope of the callback.  In some
@@ -132,9 +295,15 @@ int FaceTrackTest::callback(drishti::sdk::Array<drishti_face_tracker_result_t, 6
             // the public SDK layer can optimize for this by using teh allocator callback so that
             // memory can be allocated by the user/application layer.
             const auto& r = results[i];
-            if (r.image.image.getRows() > 0 && r.image.image.getCols() > 0)
+            if (doFrames && (rois[i].area() > 0))
             {
-                (*stack)[i].frame = drishti::sdk::drishtiToCv<drishti::sdk::Vec4b, cv::Vec4b>(r.image.image).clone();
+                auto& s = (*stack)[i];
+                s.size = { r.image.image.getCols(), r.image.image.getRows() };
+                s.frame = drishti::sdk::drishtiToCv<drishti::sdk::Vec4b, cv::Vec4b>(r.image.image)(rois[i]).clone();
+                if (rois[i] != cv::Rect({ 0, 0 }, s.size))
+                {
+                    s.roi = rois[i]; // not for the full frame fallback (no faces, or no ROI capture)
+                }
             }
             if (r.eyes.image.getRows() > 0 && r.eyes.image.getCols() > 0)
             {
@@ -144,7 +313,15 @@ int FaceTrackTest::callback(drishti::sdk::Array<drishti_face_tracker_result_t, 6
 
         // Send the stack to the user's process method via the asynchronous
         // worker thread to avoid blocking in the main face tracker callback.
-        m_impl->worker.post([this, stack] { this->process(*stack); });
+        // The frame ID travels with the job so worker spans line up with the
+        // frame that requested them.
+        const auto frame = FrameTrace::getFrame();
+        ScopedStage post(PipelineStage::kPost);
+        m_impl->worker.post([this, stack, frame] {
+            FrameTrace::setFrame(frame);
+            ScopedStage stage(PipelineStage::kProcess);
+            this->process(*stack);
+        });
     }
 
     return 0;
@@ -156,10 +333,62 @@ void FaceTrackTest::setCaptureSphere(const std::array<float, 3>& center, float r
     m_impl->captureInterval = seconds;
 }
 
+void FaceTrackTest::setResultHandler(const ResultHandler& handler)
+{
+    m_impl->resultHandler = handler;
+}
+
+void FaceTrackTest::setEyeHandler(const EyeHandler& handler)
+{
+    m_impl->eyeHandler = handler;
+}
+
+void FaceTrackTest::setWriter(const std::shared_ptr<CaptureWriter>& writer)
+{
+    m_impl->writer = writer;
+}
+
+void FaceTrackTest::setDedupe(int threshold)
+{
+    m_impl->dedupe = (threshold >= 0) ? detail::make_unique<CaptureDedupe>(threshold) : nullptr;
+}
+
+void FaceTrackTest::setEyeQuality(float threshold)
+{
+    m_impl->eyeQuality = threshold;
+}
+
+void FaceTrackTest::setCaptureRoi(float padding, const cv::Size& size)
+{
+    m_impl->roiPadding = padding;
+    m_impl->roiSize = size;
+}
+
+void FaceTrackTest::setMotionLimits(float velocity, float acceleration, int frames)
+{
+    MotionGate::Settings settings;
+    settings.maxVelocity = velocity;
+    settings.maxAcceleration = acceleration;
+    settings.frames = frames;
+    m_impl->motion = detail::make_unique<MotionGate>(settings);
+}
+
+void FaceTrackTest::setCaptureBudget(std::size_t bytes, BudgetPolicy policy)
+{
+    m_impl->budget = bytes;
+    m_impl->policy = policy;
+}
+
+void FaceTrackTest::setCaptureInterval(double seconds)
+{
+    m_impl->captureInterval = seconds;
+}
+
 bool FaceTrackTest::shouldCapture(const drishti_face_tracker_result_t& faces)
 {
     bool status = false;
 
+    const auto& motion = m_impl->motion;
     if (m_impl->sphere.radius > 0.f)
     {
         // Comnpute simple/global FPS
@@ -174,8 +403,15 @@ bool FaceTrackTest::shouldCapture(const drishti_face_tracker_result_t& faces)
                 m_impl->logger->info("Error {}", error);
                 if (error < m_impl->sphere.radius)
                 {
+                    if (motion && !motion->isStill({ { f.position[0], f.position[1], f.position[2] } }))
+                    {
+                        PipelineStats::get().capturesMoving++; // likely motion blur, skip the readback
+                        continue;
+                    }
+
                     status = true;
                     m_impl->captureTimestamp = now; // don't repeat captures too foten
+                    m_impl->capturePosition = { { f.position[0], f.position[1], f.position[2] } };
                     break;
                 }
             }
@@ -193,23 +429,55 @@ bool FaceTrackTest::shouldCapture(const drishti_face_tracker_result_t& faces)
 // frame-to-frame motion.
 drishti_request_t FaceTrackTest::trigger(const drishti_face_tracker_result_t& faces, double timestamp, std::uint32_t tex)
 {
+    ScopedStage stage(PipelineStage::kTrigger);
+
     m_impl->logger->info("trigger: Received results at time {}}", timestamp);
 
-    if (m_impl->display)
+    if (m_impl->display && m_impl->doPreview)
     {
         m_impl->updatePreview(tex);
     }
 
-    if (shouldCapture(faces))
+    if (m_impl->resultHandler)
+    {
+        m_impl->resultHandler(faces, timestamp);
+    }
+
+    // The motion estimate needs every frame (not just the ones that are
+    // eligible for capture, or the ones deferred by backpressure):
+    auto& motion = m_impl->motion;
+    if (motion)
+    {
+        std::vector<MotionGate::Position> positions;
+        for (const auto& f : faces.faceModels)
+        {
+            positions.push_back({ { f.position[0], f.position[1], f.position[2] } });
+        }
+        motion->update(positions, timestamp);
+    }
+
+    // Don't request more data until the in-flight captures drain (the capture
+    // interval isn't consumed, so the capture happens as soon as there is room):
+    const auto& budget = m_impl->budget;
+    if (budget && (m_impl->policy == BudgetPolicy::kBackpressure) && (PipelineStats::get().bytesInFlight >= budget))
+    {
+        PipelineStats::get().capturesDeferred++;
+        return { 0 };
+    }
+
+    bool doFrames = true;
+    if (shouldCapture(faces) && m_impl->reserve(faces, doFrames))
     {
+        PipelineStats::get().captures++;
+
         // clang-format off
         return // Here we formulate the actual request, see drishti_request_t:
         {
-            3,    // Retrieve the last N frames
-            true, // Get frames in user memory
-            true, // Get frames as texture ID's
-            true, // Get full frame images
-            true  // Get eye crop images
+            kCaptureFrames, // Retrieve the last N frames
+            true,           // Get frames in user memory
+            true,           // Get frames as texture ID's
+            doFrames,       // Get full frame images
+            true            // Get eye crop images
         };
         // clang-format on
     }
@@ -219,6 +487,8 @@ drishti_request_t FaceTrackTest::trigger(const drishti_face_tracker_result_t& fa
 
 int FaceTrackTest::allocator(const drishti_image_t& spec, drishti::sdk::Image4b& image)
 {
+    ScopedStage stage(PipelineStage::kAllocator);
+
     m_impl->logger->info("allocator: {} {}", spec.width, spec.height);
     return 0;
 }
@@ -268,10 +538,34 @@ void FaceTrackTest::process(StackType& stack)
         //            draw(s.frame, f);
         //        }
         
+        // Captures are grouped by the face that triggered them for deduplication:
+        std::array<float, 3> position{ { 0.f, 0.f, 0.f } };
+        if (s.face < s.result.faceModels.size())
+        {
+            const auto& f = s.result.faceModels[s.face];
+            position = { { f.position[0], f.position[1], f.position[2] } };
+        }
+
+        if (!isDuplicate(position, CaptureDedupe::kFrame, s.frame))
         { // Write the frame:
             std::stringstream ss;
-            ss << m_impl->output << "/aframe_" << std::setw(4) << std::setfill('0') << m_impl->counter << "_" << i << ".png";
-            cv::imwrite(ss.str(), s.frame);
+            ss << m_impl->output << "/aframe_" << std::setw(4) << std::setfill('0') << m_impl->counter << "_" << i;
+
+            cv::Mat frame = s.frame;
+            if (s.roi.area() && m_impl->roiSize.area() && !s.frame.empty())
+            {
+                cv::resize(s.frame, frame, m_impl->roiSize, 0, 0, cv::INTER_AREA);
+            }
+            PipelineStats::get().bytesWritten += write(ss.str() + ".png", frame, m_impl->writer.get());
+
+            if (s.roi.area() && !s.frame.empty())
+            { // The ROI offset (and scale) in the video frame:
+                std::stringstream json;
+                json << "{\"roi\":[" << s.roi.x << "," << s.roi.y << "," << s.roi.width << "," << s.roi.height << "]"
+                     << ",\"size\":[" << s.size.width << "," << s.size.height << "]"
+                     << ",\"scale\":[" << static_cast<double>(frame.cols) / s.roi.width << "," << static_cast<double>(frame.rows) / s.roi.height << "]}\n";
+                PipelineStats::get().bytesWritten += write(ss.str() + ".json", json.str(), m_impl->writer.get());
+            }
         }
         
         // Example: draw eye models for nearest face
@@ -281,17 +575,136 @@ void FaceTrackTest::process(StackType& stack)
         //            draw(s.eyes, e);
         //        }
         
+        // Score the eye crop before paying to encode and write it:
+        EyeQuality quality;
+        bool accepted = true;
+        if ((m_impl->eyeQuality >= 0.f) && !s.eyes.empty())
+        {
+            quality = EyeQuality(s.eyes, FrameResult(m_impl->counter, 0.0, s.result).eyes);
+            if (quality.score < m_impl->eyeQuality)
+            {
+                PipelineStats::get().eyesRejected++;
+                accepted = false;
+            }
+        }
+
+        if (accepted && !isDuplicate(position, CaptureDedupe::kEyes, s.eyes))
         { // Write the eyes:
             std::stringstream ss;
-            ss << m_impl->output << "/aeye_" << std::setw(4) << std::setfill('0') << m_impl->counter << "_" << i << ".png";
-            cv::imwrite(ss.str(), s.eyes);
+            ss << m_impl->output << "/aeye_" << std::setw(4) << std::setfill('0') << m_impl->counter << "_" << i;
+            PipelineStats::get().bytesWritten += write(ss.str() + ".png", s.eyes, m_impl->writer.get());
+
+            if (m_impl->eyeQuality >= 0.f)
+            {
+                PipelineStats::get().bytesWritten += write(ss.str() + ".json", quality.toJson() + "\n", m_impl->writer.get());
+            }
+
+            if (m_impl->eyeHandler && !s.eyes.empty())
+            {
+                m_impl->eyeHandler(s.eyes, ss.str());
+            }
         }
     }
     m_impl->counter++;
 }
 
+bool FaceTrackTest::isDuplicate(const std::array<float, 3>& position, int kind, const cv::Mat& image)
+{
+    if (m_impl->dedupe && m_impl->dedupe->isDuplicate(position, static_cast<CaptureDedupe::Kind>(kind), image))
+    {
+        auto& stats = PipelineStats::get();
+        stats.duplicatesSuppressed++;
+        stats.duplicateBytes += image.total() * image.elemSize();
+        return true;
+    }
+    return false;
+}
+
 // Utility {
 
+// Encode and write the image, return the number of bytes written (0 if
+// the buffer was queued, the writer counts the bytes on completion):
+std::size_t write(const std::string& filename, const cv::Mat& image, CaptureWriter* writer)
+{
+    std::vector<std::uint8_t> buffer;
+    if (image.empty() || !cv::imencode(".png", image, buffer))
+    {
+        return 0;
+    }
+
+    if (writer)
+    {
+        writer->write(filename, std::move(buffer));
+        return 0;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    if (!ofs.write(reinterpret_cast<const char*>(buffer.data()), buffer.size()))
+    {
+        return 0;
+    }
+    return buffer.size();
+}
+
+// Write a text file (i.e., capture metadata), same return value as above:
+std::size_t write(const std::string& filename, const std::string& text, CaptureWriter* writer)
+{
+    if (writer)
+    {
+        writer->write(filename, std::vector<std::uint8_t>(text.begin(), text.end()));
+        return 0;
+    }
+
+    std::ofstream ofs(filename, std::ios::binary);
+    return ofs.write(text.data(), text.size()) ? text.size() : 0;
+}
+
+// Bounding box of one face's landmarks grown by padding * box size on each
+// side and clipped to the frame, the full frame if there is no such face:
+cv::Rect getRoi(const drishti_face_tracker_result_t& result, int face, const cv::Size& size, float padding)
+{
+    const cv::Rect frame({ 0, 0 }, size);
+    if ((face < 0) || (face >= static_cast<int>(result.faceModels.size())))
+    {
+        return frame;
+    }
+
+    cv::Rect bounds;
+    const auto landmarks = drishti::sdk::drishtiToCv(result.faceModels[face].landmarks);
+    if (!landmarks.empty())
+    {
+        bounds = cv::boundingRect(landmarks);
+    }
+
+    if (bounds.area() == 0)
+    {
+        return frame;
+    }
+
+    const int dx = static_cast<int>(std::round(bounds.width * padding));
+    const int dy = static_cast<int>(std::round(bounds.height * padding));
+    const cv::Rect roi = cv::Rect(bounds.x - dx, bounds.y - dy, bounds.width + 2 * dx, bounds.height + 2 * dy) & frame;
+    return roi.area() ? roi : frame;
+}
+
+int getNearestFace(const drishti_face_tracker_result_t& result, const std::array<float, 3>& position)
+{
+    int best = 0;
+    float bestDistance = std::numeric_limits<float>::max();
+    for (int i = 0; i < result.faceModels.size(); i++)
+    {
+        const auto& f = result.faceModels[i];
+        const float dx = f.position[0] - position[0], dy = f.position[1] - position[1], dz = f.position[2] - position[2];
+        const float distance = dx * dx + dy * dy + dz * dz;
+        if (distance < bestDistance)
+        {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
 void draw(cv::Mat& image, const drishti::sdk::Eye& eye)
 {
     auto eyelids = drishti::sdk::drishtiToCv(eye.getEyelids());
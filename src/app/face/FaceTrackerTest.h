@@ -16,9 +16,12 @@
 
 #include <spdlog/spdlog.h> // for portable logging
 
+#include <functional>
 #include <memory>
 
 // See: https://github.com/elucideye/drishti/blob/master/src/lib/drishti/drishti/ut/test-FaceTracker.cpp
+class CaptureWriter;
+
 class FaceTrackTest
 {
 public:
@@ -28,9 +31,26 @@ public:
         cv::Mat frame;
         cv::Mat eyes;
         drishti_face_tracker_result_t result;
+        cv::Rect roi;  // region of the video frame in frame (ROI capture), empty for a full frame
+        cv::Size size; // video frame size
+        int face = 0;  // index of the face that triggered the capture (in result)
     };
     using StackType = std::vector<FrameStorage>;
 
+    // Action taken when a capture would exceed the in-flight byte budget:
+    enum class BudgetPolicy
+    {
+        kSkip,        // drop the capture
+        kEyesOnly,    // keep the eye crops, drop the full frames
+        kBackpressure // stop requesting captures in trigger() until memory drains
+    };
+
+    // Observe the per-frame tracking results (called from trigger()):
+    using ResultHandler = std::function<void(const drishti_face_tracker_result_t& faces, double timestamp)>;
+
+    // Receive each captured eye crop with its output filename prefix (called from process()):
+    using EyeHandler = std::function<void(const cv::Mat& eyes, const std::string& prefix)>;
+
     FaceTrackTest(std::shared_ptr<spdlog::logger>& logger, const std::string& sOutput);
     ~FaceTrackTest();
 
@@ -49,17 +69,54 @@ public:
     // simple logging for the purpose of illustration.
     virtual void process(StackType& stack);
 
+    void setResultHandler(const ResultHandler& handler);
+    void setEyeHandler(const EyeHandler& handler);
+
+    // Queue encoded captures to a background writer (default: blocking writes in process()):
+    void setWriter(const std::shared_ptr<CaptureWriter>& writer);
+
+    // Skip frames and eye crops within <threshold> bits (dHash Hamming distance)
+    // of the last capture written for the same face (-1 == disabled):
+    void setDedupe(int threshold);
+
+    // Only write eye crops with EyeQuality::score >= threshold, and record the
+    // scores in a JSON file next to each crop (< 0 == disabled):
+    void setEyeQuality(float threshold);
+
+    // Copy and write only the face region (landmark bounds of the face that
+    // triggered the capture, grown by padding * size on each side), optionally
+    // rescaled to a fixed size, with the offset in a JSON file next to each
+    // frame (padding < 0 == full frame):
+    void setCaptureRoi(float padding, const cv::Size& size = {});
+
     // Logging: {
     void setCaptureSphere(const std::array<float, 3>& center, float radius, double seconds);
+    void setCaptureInterval(double seconds);
     bool shouldCapture(const drishti_face_tracker_result_t& faces);
+
+    // Only capture a face once its speed (m/s) and acceleration (m/s^2) have been
+    // under these limits for <frames> consecutive frames (0 == unlimited):
+    void setMotionLimits(float velocity, float acceleration, int frames);
     // }
 
+    // Limit capture copies waiting for process() (0 == unlimited), the bytes
+    // are reserved when trigger() requests a capture:
+    void setCaptureBudget(std::size_t bytes, BudgetPolicy policy);
+
     // Utility methods: {
     void initPreview(const cv::Size& size, GLenum textureFormat);
     void setPreviewGeometry(float tx, float ty, float sx, float sy);
+    void setPreviewEnabled(bool value);
+    bool hasPreview() const;
     void setSizeHint(const cv::Size& size);
     // }
 
+    // Wait until the queued captures have been processed:
+    void flush();
+
+    // Worker queue status (lock-free, callable from any thread):
+    std::size_t getQueueDepth() const;
+
     // Define the public callback table:
     drishti_face_tracker_t table{
         this,
@@ -69,6 +126,9 @@ public:
     };
 
 protected:
+    // Count (and return true) if dedupe is enabled and the image is a duplicate:
+    bool isDuplicate(const std::array<float, 3>& position, int kind, const cv::Mat& image);
+
     struct Impl;
     std::unique_ptr<Impl> m_impl;
 };
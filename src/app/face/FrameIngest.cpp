@@ -0,0 +1,45 @@
+/*!
+  @file   FrameIngest.cpp
+  @author David Hirvonen
+  @brief  Resize and convert input frames to the tracker format (pooled buffers).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "FrameIngest.h"
+
+#include <opencv2/imgproc.hpp>
+
+FrameIngest::FrameIngest(const cv::Size& size, bool doLuminance)
+    : size(size)
+    , doLuminance(doLuminance)
+{
+}
+
+cv::Mat& FrameIngest::operator()(cv::Mat& image)
+{
+    cv::Mat* input = &image;
+    if (image.size() != size)
+    {
+        cv::resize(image, resized, size, 0.0, 0.0, cv::INTER_AREA);
+        input = &resized;
+    }
+
+    switch (input->channels())
+    {
+        case 3:
+            cv::cvtColor(*input, output, cv::COLOR_BGR2BGRA);
+            return output;
+        case 1:
+            if (doLuminance)
+            {
+                return *input;
+            }
+            cv::cvtColor(*input, output, cv::COLOR_GRAY2BGRA);
+            return output;
+        default:
+            return *input;
+    }
+}
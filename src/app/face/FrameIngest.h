@@ -0,0 +1,38 @@
+/*!
+  @file   FrameIngest.h
+  @author David Hirvonen
+  @brief  Resize and convert input frames to the tracker format (pooled buffers).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#ifndef __FrameIngest_h__
+#define __FrameIngest_h__
+
+#include <opencv2/core.hpp>
+
+// Frames are downscaled with an area filter (vectorized in OpenCV) and
+// converted to 4 channels in buffers that are reused from frame to frame,
+// so steady state ingest doesn't allocate.  Single channel frames (i.e., the
+// Y plane of raw YUV input) can be passed through for GL_LUMINANCE upload,
+// otherwise they are expanded to BGRA.
+class FrameIngest
+{
+public:
+    FrameIngest(const cv::Size& size, bool doLuminance = false);
+
+    // The result is valid until the next call (or may alias the input):
+    cv::Mat& operator()(cv::Mat& image);
+
+    const cv::Size& getSize() const { return size; }
+
+protected:
+    cv::Size size;
+    bool doLuminance = false;
+    cv::Mat resized;
+    cv::Mat output;
+};
+
+#endif // __FrameIngest_h__
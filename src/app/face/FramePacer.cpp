@@ -0,0 +1,222 @@
+/*!
+  @file   FramePacer.cpp
+  @author David Hirvonen
+  @brief  Real-time paced playback of a video source (drop frames when late).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "FramePacer.h"
+#include "FrameTrace.h"
+#include "PipelineStats.h"
+#include "ThreadTopology.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// clang-format off
+namespace detail
+{
+    template <typename Value, typename... Arguments>
+    std::unique_ptr<Value> make_unique(Arguments&&... arguments_for_constructor)
+    {
+        return std::unique_ptr<Value>(new Value(std::forward<Arguments>(arguments_for_constructor)...));
+    }
+}
+// clang-format on
+
+struct FramePacer::Impl
+{
+    Impl(std::shared_ptr<cv::VideoCapture>& video, double fps, std::size_t count)
+        : video(video)
+        , period(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps)))
+        , count(count)
+    {
+        if (!(fps > 0.0))
+        {
+            throw std::runtime_error("FramePacer: the frame rate must be positive");
+        }
+
+        thread = std::thread([this]() { loop(); });
+    }
+
+    ~Impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        cv.notify_all();
+        thread.join();
+    }
+
+    void loop()
+    {
+        FrameTrace::get().setThreadName("capture");
+        ThreadTopology::get().apply("capture");
+
+        // Frames are read ahead of their release time, so decode cost only
+        // matters when the source can't keep up with the frame rate:
+        Frame back;
+        cv::Mat captured;
+        Clock::time_point start;
+        for (std::size_t i = 0; running && ((count == 0) || (i < count)); i++)
+        {
+            if (!video->read(captured) || captured.empty())
+            {
+                break;
+            }
+
+            if (i == 0)
+            {
+                start = Clock::now(); // the clock starts with the first frame
+            }
+
+            // Sources can return shared buffers (valid until the next read), the
+            // copy goes into a recycled buffer:
+            captured.copyTo(back.image);
+            back.index = i;
+            back.scheduled = start + period * static_cast<Clock::rep>(i);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if (cv.wait_until(lock, back.scheduled, [this] { return !running; }))
+            {
+                break;
+            }
+
+            if (Clock::now() > (back.scheduled + period))
+            {
+                lateCount++;
+            }
+
+            if (full)
+            {
+                droppedCount++; // the consumer was busy
+                PipelineStats::get().framesDropped++;
+            }
+            std::swap(slot, back);
+            full = true;
+            releasedCount++;
+            cv.notify_all();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        cv.notify_all();
+    }
+
+    bool pop(Frame& frame)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return full || finished; });
+        if (!full)
+        {
+            return false;
+        }
+
+        std::swap(frame, slot); // the previous frame buffer is recycled
+        full = false;
+        return true;
+    }
+
+    void done(Clock::time_point scheduled)
+    {
+        const auto latency = std::chrono::duration<double>(Clock::now() - scheduled).count();
+        const auto microseconds = static_cast<std::uint64_t>(std::max(latency, 0.0) * 1e6);
+        PipelineStats::get().frameLatency.add(microseconds);
+        latencies.add(microseconds);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (latencies.count.load(std::memory_order_relaxed) > 1)
+        {
+            jitter += std::abs(latency - previous);
+        }
+        previous = latency;
+    }
+
+    std::shared_ptr<cv::VideoCapture> video;
+    Clock::duration period;
+    std::size_t count;
+
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<bool> running{ true };
+    bool finished = false;
+
+    Frame slot; // single slot mailbox
+    bool full = false;
+
+    std::size_t releasedCount = 0;
+    std::size_t droppedCount = 0;
+    std::size_t lateCount = 0;
+
+    PipelineStats::Latency latencies; // processed frames (this playback only)
+    double previous = 0.0;            // last latency (seconds)
+    double jitter = 0.0;              // sum of absolute consecutive differences
+};
+
+FramePacer::FramePacer(std::shared_ptr<cv::VideoCapture>& video, double fps, std::size_t count)
+{
+    m_impl = detail::make_unique<Impl>(video, fps, count);
+}
+
+FramePacer::~FramePacer() = default;
+
+bool FramePacer::pop(Frame& frame)
+{
+    return m_impl->pop(frame);
+}
+
+void FramePacer::done(Clock::time_point scheduled)
+{
+    m_impl->done(scheduled);
+}
+
+std::size_t FramePacer::released() const
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return m_impl->releasedCount;
+}
+
+std::size_t FramePacer::dropped() const
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return m_impl->droppedCount;
+}
+
+std::size_t FramePacer::late() const
+{
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return m_impl->lateCount;
+}
+
+void FramePacer::report(spdlog::logger& logger) const
+{
+    const auto& latencies = m_impl->latencies;
+    const auto processed = latencies.count.load(std::memory_order_relaxed);
+    double jitter = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(m_impl->mutex);
+        jitter = (processed > 1) ? (m_impl->jitter / (processed - 1)) : 0.0;
+    }
+
+    const auto released = this->released();
+    const auto dropped = this->dropped();
+    const double rate = released ? (100.0 * dropped / released) : 0.0;
+    logger.info("Playback: {} frames released, {} processed, {} dropped ({}%), {} late", released, processed, dropped, rate, late());
+
+    if (processed)
+    {
+        const auto percentile = [&](double p) { return latencies.getPercentile(p) * 1e-3; };
+        const double max = latencies.max.load(std::memory_order_relaxed) * 1e-3;
+        logger.info("Playback latency (ms): p50 {} p90 {} p99 {} max {} jitter {}", percentile(0.5), percentile(0.9), percentile(0.99), max, jitter * 1e3);
+    }
+}
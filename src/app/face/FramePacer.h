@@ -0,0 +1,67 @@
+/*!
+  @file   FramePacer.h
+  @author David Hirvonen
+  @brief  Real-time paced playback of a video source (drop frames when late).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  A capture thread reads the source ahead of time and releases frame i at
+  start + i / fps into a single slot mailbox.  A frame that is still in the
+  mailbox when the next one is released is dropped (newest wins), like a
+  live camera with a busy consumer.  The consumer reports when the tracker
+  output for a frame is available, and the latency is measured from the
+  scheduled release:
+
+  latency = done - (start + i / fps)
+
+  Jitter is the mean absolute difference between consecutive latencies.
+
+*/
+
+#ifndef __FramePacer_h__
+#define __FramePacer_h__
+
+#include <opencv2/highgui.hpp>
+
+#include <spdlog/spdlog.h> // for portable logging
+
+#include <chrono>
+#include <memory>
+
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame
+    {
+        cv::Mat image;             // owned by the consumer until the next pop()
+        std::size_t index = 0;     // frames released by the pacer (including drops)
+        Clock::time_point scheduled;
+    };
+
+    // Read at most count frames (0 == until the source ends) at the specified rate:
+    FramePacer(std::shared_ptr<cv::VideoCapture>& video, double fps, std::size_t count = 0);
+    ~FramePacer(); // stop the capture thread
+
+    // Wait for the next released frame, returns false at the end of the source:
+    bool pop(Frame& frame);
+
+    // Called when the tracker output for the frame released at the scheduled
+    // time is available (end-to-end latency):
+    void done(Clock::time_point scheduled);
+
+    std::size_t released() const; // frames released into the mailbox
+    std::size_t dropped() const;   // frames overwritten before pop()
+    std::size_t late() const;      // frames released more than one period late (slow source)
+
+    // Log the playback summary (drops, latency percentiles and jitter):
+    void report(spdlog::logger& logger) const;
+
+protected:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+#endif // __FramePacer_h__
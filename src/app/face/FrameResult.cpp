@@ -0,0 +1,70 @@
+/*!
+  @file   FrameResult.cpp
+  @author David Hirvonen
+  @brief  Per-frame face tracking results (owned copy) with JSON lines output.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "FrameResult.h"
+
+#include <drishti/drishti_cv.hpp>
+
+#include <ostream>
+
+FrameResult::FrameResult(std::uint64_t frame, double timestamp, const drishti_face_tracker_result_t& result)
+    : frame(frame)
+    , timestamp(timestamp)
+{
+    for (const auto& f : result.faceModels)
+    {
+        faces.push_back({ { { f.position[0], f.position[1], f.position[2] } }, drishti::sdk::drishtiToCv(f.landmarks) });
+    }
+
+    for (const auto& e : result.eyeModels)
+    {
+        eyes.push_back({ drishti::sdk::drishtiToCv(e.getIris()), drishti::sdk::drishtiToCv(e.getEyelids()) });
+    }
+}
+
+static std::ostream& writePoints(std::ostream& os, const std::vector<cv::Point2f>& points)
+{
+    const char* separator = "";
+    os << "[";
+    for (const auto& p : points)
+    {
+        os << separator << "[" << p.x << "," << p.y << "]";
+        separator = ",";
+    }
+    return os << "]";
+}
+
+std::ostream& operator<<(std::ostream& os, const FrameResult& result)
+{
+    os << "{\"frame\":" << result.frame << ",\"timestamp\":" << result.timestamp << ",\"faces\":[";
+
+    const char* separator = "";
+    for (const auto& f : result.faces)
+    {
+        os << separator << "{\"position\":[" << f.position[0] << "," << f.position[1] << "," << f.position[2] << "]"
+           << ",\"landmarks\":";
+        writePoints(os, f.landmarks) << "}";
+        separator = ",";
+    }
+
+    os << "],\"eyes\":[";
+
+    separator = "";
+    for (const auto& e : result.eyes)
+    {
+        const auto& iris = e.iris;
+        os << separator << "{\"iris\":[" << iris.center.x << "," << iris.center.y << "," << iris.size.width << "," << iris.size.height << "," << iris.angle << "]"
+           << ",\"eyelids\":";
+        writePoints(os, e.eyelids) << "}";
+        separator = ",";
+    }
+
+    return os << "]}";
+}
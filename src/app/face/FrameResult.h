@@ -0,0 +1,51 @@
+/*!
+  @file   FrameResult.h
+  @author David Hirvonen
+  @brief  Per-frame face tracking results (owned copy) with JSON lines output.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#ifndef __FrameResult_h__
+#define __FrameResult_h__
+
+#include <drishti/FaceTracker.hpp>
+
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// The SDK result is only valid for the scope of the callback, so the fields
+// needed for offline analysis are copied into plain OpenCV types.
+struct FrameResult
+{
+    struct Face
+    {
+        std::array<float, 3> position; // meters
+        std::vector<cv::Point2f> landmarks;
+    };
+
+    struct Eye
+    {
+        cv::RotatedRect iris;
+        std::vector<cv::Point2f> eyelids;
+    };
+
+    FrameResult() = default;
+    FrameResult(std::uint64_t frame, double timestamp, const drishti_face_tracker_result_t& result);
+
+    std::uint64_t frame = 0;
+    double timestamp = 0.0;
+    std::vector<Face> faces;
+    std::vector<Eye> eyes; // eye models (eye crop coordinates)
+};
+
+// Write a single line JSON record:
+std::ostream& operator<<(std::ostream& os, const FrameResult& result);
+
+#endif // __FrameResult_h__
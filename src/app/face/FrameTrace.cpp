@@ -0,0 +1,156 @@
+/*!
+  @file   FrameTrace.cpp
+  @author David Hirvonen
+  @brief  Per-frame timeline tracing with Chrome trace (JSON) export.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "FrameTrace.h"
+
+#include <fstream>
+
+struct FrameTrace::ThreadBuffer
+{
+    ThreadBuffer(std::size_t capacity, std::uint32_t tid)
+        : events(new Event[capacity])
+        , capacity(capacity)
+        , tid(tid)
+    {
+    }
+
+    std::unique_ptr<Event[]> events;
+    std::size_t capacity;
+    std::atomic<std::size_t> size{ 0 };
+    std::atomic<std::size_t> dropped{ 0 };
+    std::uint32_t tid;
+    std::string name; // guarded by FrameTrace::mutex
+};
+
+// Current frame ID for the calling thread:
+static thread_local std::uint64_t sFrame = 0;
+
+FrameTrace& FrameTrace::get()
+{
+    static FrameTrace trace;
+    return trace;
+}
+
+FrameTrace::FrameTrace()
+    : epoch(std::chrono::steady_clock::now())
+{
+}
+
+FrameTrace::~FrameTrace() = default;
+
+void FrameTrace::setFrame(std::uint64_t frame)
+{
+    sFrame = frame;
+}
+
+std::uint64_t FrameTrace::getFrame()
+{
+    return sFrame;
+}
+
+std::int64_t FrameTrace::now() const
+{
+    const auto elapsed = std::chrono::steady_clock::now() - epoch;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+FrameTrace::ThreadBuffer* FrameTrace::getThreadBuffer()
+{
+    // The buffer is owned by the (process wide) tracer and outlives the
+    // thread, so events survive until the final flush.
+    static thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto tid = static_cast<std::uint32_t>(buffers.size() + 1);
+        buffers.emplace_back(new ThreadBuffer(capacity, tid));
+        buffer = buffers.back().get();
+    }
+    return buffer;
+}
+
+void FrameTrace::setThreadName(const std::string& name)
+{
+    auto* buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer->name = name;
+}
+
+void FrameTrace::record(const char* name, std::uint64_t frame, std::int64_t begin, std::int64_t end)
+{
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    auto* buffer = getThreadBuffer();
+
+    // Single producer: only the owning thread writes past the published size.
+    const auto size = buffer->size.load(std::memory_order_relaxed);
+    if (size >= buffer->capacity)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer->events[size] = { name, frame, begin, end };
+    buffer->size.store(size + 1, std::memory_order_release);
+}
+
+std::size_t FrameTrace::dropped() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::size_t total = 0;
+    for (const auto& buffer : buffers)
+    {
+        total += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+bool FrameTrace::flush(const std::string& filename) const
+{
+    std::ofstream ofs(filename);
+    if (!ofs)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const char* separator = "\n";
+    ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (const auto& buffer : buffers)
+    {
+        if (!buffer->name.empty())
+        {
+            ofs << separator
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+            separator = ",\n";
+        }
+
+        const auto size = buffer->size.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < size; i++)
+        {
+            const auto& e = buffer->events[i];
+            ofs << separator
+                << "{\"name\":\"" << e.name << "\",\"cat\":\"frame\",\"ph\":\"X\""
+                << ",\"ts\":" << e.begin << ",\"dur\":" << (e.end - e.begin)
+                << ",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"args\":{\"frame\":" << e.frame << "}}";
+            separator = ",\n";
+        }
+    }
+    ofs << "\n]}\n";
+
+    return ofs.good();
+}
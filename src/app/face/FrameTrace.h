@@ -0,0 +1,77 @@
+/*!
+  @file   FrameTrace.h
+  @author David Hirvonen
+  @brief  Per-frame timeline tracing with Chrome trace (JSON) export.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#ifndef __FrameTrace_h__
+#define __FrameTrace_h__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Each thread appends complete spans to its own fixed capacity buffer, so
+// the recording path never takes a lock.  A reader (flush) only sees the
+// events published by the atomic size counter, and can therefore run at any
+// time from any thread.  Events are exported in the Chrome trace format,
+// which can be loaded directly in chrome://tracing or https://ui.perfetto.dev.
+class FrameTrace
+{
+public:
+    struct Event
+    {
+        const char* name; // must have static storage duration
+        std::uint64_t frame;
+        std::int64_t begin; // microseconds
+        std::int64_t end;   // microseconds
+    };
+
+    static FrameTrace& get();
+    ~FrameTrace();
+
+    void setEnabled(bool value) { enabled = value; }
+    bool isEnabled() const { return enabled; }
+
+    // Only affects threads that haven't recorded an event yet:
+    void setCapacity(std::size_t events) { capacity = events; }
+
+    // Name the calling thread in the exported timeline:
+    void setThreadName(const std::string& name);
+
+    // Tag the calling thread with the ID of the frame it is working on:
+    static void setFrame(std::uint64_t frame);
+    static std::uint64_t getFrame();
+
+    // Microseconds since the trace epoch:
+    std::int64_t now() const;
+
+    void record(const char* name, std::uint64_t frame, std::int64_t begin, std::int64_t end);
+
+    bool flush(const std::string& filename) const;
+
+    std::size_t dropped() const;
+
+protected:
+    FrameTrace();
+
+    struct ThreadBuffer;
+    ThreadBuffer* getThreadBuffer();
+
+    std::chrono::steady_clock::time_point epoch;
+    std::atomic<bool> enabled{ false };
+    std::atomic<std::size_t> capacity{ 1 << 16 };
+
+    mutable std::mutex mutex; // guards buffer registration and thread names
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+#endif // __FrameTrace_h__
@@ -0,0 +1,253 @@
+/*!
+  @file   HardwareCounters.cpp
+  @author David Hirvonen
+  @brief  CPU performance counters per pipeline stage (Linux perf_event_open).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "HardwareCounters.h"
+#include "PipelineStage.h"
+#include "PipelineStats.h"
+
+#include <atomic>
+#include <cstring>
+#include <ostream>
+
+// clang-format off
+#if defined(__linux__)
+#  define DRISHTI_SDK_TEST_HAVE_PERF_EVENT 1
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#  include <cerrno>
+#endif
+// clang-format on
+
+namespace
+{
+    const char* kNames[] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+    struct Counters
+    {
+        std::atomic<std::uint64_t> calls{ 0 };
+        std::array<std::atomic<std::uint64_t>, HardwareCounters::kEvents> totals{};
+    };
+
+    std::array<Counters, static_cast<int>(PipelineStage::kCount)> gStages;
+    std::atomic<bool> gEnabled{ false };
+    std::atomic<unsigned> gAvailable{ 0 }; // bitmask of events opened on any thread
+    std::atomic<bool> gScaled{ false };    // the kernel multiplexed a group (counts are estimates)
+    std::string gError;
+
+#if defined(DRISHTI_SDK_TEST_HAVE_PERF_EVENT)
+    // One counter group per thread (created on first use):
+    struct Group
+    {
+        Group()
+        {
+            static const std::array<std::uint64_t, HardwareCounters::kEvents> configs = { {
+                PERF_COUNT_HW_CPU_CYCLES,
+                PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_CACHE_MISSES,
+                PERF_COUNT_HW_BRANCH_MISSES,
+            } };
+
+            slots.fill(-1);
+            for (int i = 0; i < HardwareCounters::kEvents; i++)
+            {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = configs[i];
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                attr.disabled = (leader < 0) ? 1 : 0;
+                attr.exclude_kernel = 1; // allowed with perf_event_paranoid <= 2
+                attr.exclude_hv = 1;
+
+                const int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+                if (fd < 0)
+                {
+                    error = errno;
+                    continue;
+                }
+
+                if (leader < 0)
+                {
+                    leader = fd;
+                }
+                fds[size] = fd;
+                slots[i] = size++;
+            }
+
+            if (leader >= 0)
+            {
+                ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+            gAvailable.fetch_or(getMask(), std::memory_order_relaxed);
+        }
+
+        ~Group()
+        {
+            for (int i = 0; i < size; i++)
+            {
+                close(fds[i]);
+            }
+        }
+
+        bool read(HardwareCounters::Sample& sample) const
+        {
+            // PERF_FORMAT_GROUP with both times: { nr, time_enabled, time_running, values[nr] }
+            std::array<std::uint64_t, HardwareCounters::kEvents + 3> buffer;
+            const auto bytes = static_cast<ssize_t>(sizeof(std::uint64_t) * (size + 3));
+            if ((leader < 0) || (::read(leader, buffer.data(), bytes) != bytes))
+            {
+                return false;
+            }
+
+            const auto enabled = buffer[1];
+            const auto running = buffer[2];
+            if (!running)
+            {
+                return false; // never scheduled, there is nothing to scale
+            }
+
+            // The group was multiplexed with other events, extrapolate the counts:
+            const bool scaled = (running < enabled);
+            if (scaled)
+            {
+                gScaled.store(true, std::memory_order_relaxed);
+            }
+
+            for (int i = 0; i < HardwareCounters::kEvents; i++)
+            {
+                const auto value = (slots[i] >= 0) ? buffer[slots[i] + 3] : 0;
+                sample[i] = scaled ? static_cast<std::uint64_t>(static_cast<double>(value) * enabled / running) : value;
+            }
+            return true;
+        }
+
+        unsigned getMask() const
+        {
+            unsigned mask = 0;
+            for (int i = 0; i < HardwareCounters::kEvents; i++)
+            {
+                mask |= (slots[i] >= 0) ? (1u << i) : 0u;
+            }
+            return mask;
+        }
+
+        int leader = -1;
+        int size = 0;
+        int error = 0; // errno of the last failed event
+        std::array<int, HardwareCounters::kEvents> fds{};
+        std::array<int, HardwareCounters::kEvents> slots{}; // event -> group read index (-1 == unavailable)
+    };
+
+    Group& getGroup()
+    {
+        thread_local Group group;
+        return group;
+    }
+#endif
+}
+
+bool HardwareCounters::enable()
+{
+#if defined(DRISHTI_SDK_TEST_HAVE_PERF_EVENT)
+    const auto& group = getGroup();
+    if (group.leader < 0)
+    {
+        gError = std::string("perf_event_open: ") + std::strerror(group.error) + " (see /proc/sys/kernel/perf_event_paranoid)";
+        return false;
+    }
+
+    if (group.error)
+    {
+        gError = std::string("some counters are unavailable: ") + std::strerror(group.error);
+    }
+    gEnabled = true;
+    return true;
+#else
+    gError = "hardware counters are only supported on Linux";
+    return false;
+#endif
+}
+
+bool HardwareCounters::isEnabled()
+{
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+const std::string& HardwareCounters::getError()
+{
+    return gError;
+}
+
+bool HardwareCounters::read(Sample& sample)
+{
+#if defined(DRISHTI_SDK_TEST_HAVE_PERF_EVENT)
+    return isEnabled() && getGroup().read(sample);
+#else
+    return false;
+#endif
+}
+
+void HardwareCounters::add(PipelineStage stage, const Sample& begin)
+{
+    Sample end;
+    if (!read(end))
+    {
+        return;
+    }
+
+    auto& counters = gStages[static_cast<int>(stage)];
+    counters.calls.fetch_add(1, std::memory_order_relaxed);
+    for (int i = 0; i < kEvents; i++)
+    {
+        // Scaled estimates can step backwards when the running fraction changes:
+        counters.totals[i].fetch_add((end[i] > begin[i]) ? (end[i] - begin[i]) : 0, std::memory_order_relaxed);
+    }
+}
+
+void HardwareCounters::report(std::ostream& os)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    const auto frames = PipelineStats::get().frames.load(std::memory_order_relaxed);
+    const auto available = gAvailable.load(std::memory_order_relaxed);
+    os << "hw.scaled " << (gScaled.load(std::memory_order_relaxed) ? 1 : 0) << "\n";
+    for (int i = 0; i < static_cast<int>(PipelineStage::kCount); i++)
+    {
+        const auto& counters = gStages[i];
+        if (!counters.calls.load(std::memory_order_relaxed))
+        {
+            continue;
+        }
+
+        const char* name = toString(static_cast<PipelineStage>(i));
+        Sample totals;
+        for (int j = 0; j < kEvents; j++)
+        {
+            totals[j] = counters.totals[j].load(std::memory_order_relaxed);
+            if ((available & (1u << j)) && frames)
+            {
+                os << "hw.stage." << name << "." << kNames[j] << "_per_frame " << (totals[j] / frames) << "\n";
+            }
+        }
+
+        const unsigned ipc = (1u << kCycles) | (1u << kInstructions);
+        if (((available & ipc) == ipc) && totals[kCycles])
+        {
+            os << "hw.stage." << name << ".ipc " << (static_cast<double>(totals[kInstructions]) / totals[kCycles]) << "\n";
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/*!
+  @file   HardwareCounters.h
+  @author David Hirvonen
+  @brief  CPU performance counters per pipeline stage (Linux perf_event_open).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  When enabled, each thread that enters a ScopedStage lazily opens a group of
+  user space counters (cycles, instructions, cache misses, branch misses) for
+  itself, and the counter deltas around each stage are accumulated per stage.
+  Counters that the kernel doesn't permit (see perf_event_paranoid) or the CPU
+  doesn't support are skipped, and without any counters (or on other
+  platforms) the functions are no-ops.  When the kernel multiplexes the
+  group (more events than hardware counters) the counts are scaled by the
+  fraction of time the group was running, and the report says so.
+
+*/
+
+#ifndef __HardwareCounters_h__
+#define __HardwareCounters_h__
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+enum class PipelineStage; // PipelineStage.h (which includes this header)
+
+class HardwareCounters
+{
+public:
+    enum Event
+    {
+        kCycles,
+        kInstructions,
+        kCacheMisses,
+        kBranchMisses,
+        kEvents
+    };
+
+    using Sample = std::array<std::uint64_t, kEvents>;
+
+    // Probe the counters on the calling thread, returns false (see getError()) if none can be opened:
+    static bool enable();
+    static bool isEnabled();
+    static const std::string& getError();
+
+    // Read the calling thread's counters, returns false if they aren't available:
+    static bool read(Sample& sample);
+
+    // Accumulate the counters since begin for a stage:
+    static void add(PipelineStage stage, const Sample& begin);
+
+    // Write "key value" lines (per frame averages and IPC):
+    static void report(std::ostream& os);
+};
+
+#endif // __HardwareCounters_h__
@@ -0,0 +1,335 @@
+/*!
+  @file   MetricsServer.cpp
+  @author David Hirvonen
+  @brief  Minimal HTTP listener exposing PipelineStats in the Prometheus text format.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "MetricsServer.h"
+#include "PipelineStats.h"
+
+#include <atomic>
+#include <limits>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// clang-format off
+#if defined(__unix__) || defined(__APPLE__)
+#  define DRISHTI_SDK_TEST_HAVE_TCP_SOCKETS 1
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+// clang-format on
+
+#if defined(MSG_NOSIGNAL)
+static const int kSendFlags = MSG_NOSIGNAL;
+#else
+static const int kSendFlags = 0;
+#endif
+
+// clang-format off
+namespace detail
+{
+    template <typename Value, typename... Arguments>
+    std::unique_ptr<Value> make_unique(Arguments&&... arguments_for_constructor)
+    {
+        return std::unique_ptr<Value>(new Value(std::forward<Arguments>(arguments_for_constructor)...));
+    }
+}
+// clang-format on
+
+static void writeCounter(std::ostream& os, const char* name, const char* help, std::uint64_t value)
+{
+    os << "# HELP " << name << " " << help << "\n";
+    os << "# TYPE " << name << " counter\n";
+    os << name << " " << value << "\n";
+}
+
+// Write a double without losing precision (the stream default is 6 digits):
+static std::ostream& writeDouble(std::ostream& os, double value)
+{
+    const auto precision = os.precision(std::numeric_limits<double>::max_digits10);
+    os << value;
+    os.precision(precision);
+    return os;
+}
+
+static void writeGauge(std::ostream& os, const char* name, const char* help, std::uint64_t value)
+{
+    os << "# HELP " << name << " " << help << "\n";
+    os << "# TYPE " << name << " gauge\n";
+    os << name << " " << value << "\n";
+}
+
+static void writeGauge(std::ostream& os, const char* name, const char* help, double value)
+{
+    os << "# HELP " << name << " " << help << "\n";
+    os << "# TYPE " << name << " gauge\n";
+    writeDouble(os << name << " ", value) << "\n";
+}
+
+// Buckets are stored individually and reported cumulatively, labels is empty or "key=\"value\",":
+static void writeHistogram(std::ostream& os, const char* name, const std::string& labels, const PipelineStats::Latency& latency)
+{
+    const auto relaxed = std::memory_order_relaxed;
+    const std::string tail = labels.empty() ? std::string() : ("{" + labels.substr(0, labels.size() - 1) + "}");
+
+    std::uint64_t cumulative = 0;
+    for (std::size_t j = 0; j < latency.buckets.size(); j++)
+    {
+        cumulative += latency.buckets[j].load(relaxed);
+        os << name << "_bucket{" << labels << "le=\"";
+        if (j < latency.bounds.size())
+        {
+            os << static_cast<double>(latency.bounds[j]) * 1e-6;
+        }
+        else
+        {
+            os << "+Inf";
+        }
+        os << "\"} " << cumulative << "\n";
+    }
+    writeDouble(os << name << "_sum" << tail << " ", static_cast<double>(latency.total.load(relaxed)) * 1e-6) << "\n";
+    os << name << "_count" << tail << " " << cumulative << "\n";
+}
+
+static void writeStats(std::ostream& os, const PipelineStats& stats)
+{
+    const auto relaxed = std::memory_order_relaxed;
+
+    writeCounter(os, "drishti_frames_total", "Frames processed by the face tracker.", stats.frames.load(relaxed));
+    writeCounter(os, "drishti_callbacks_total", "Face tracker callbacks with results.", stats.callbacks.load(relaxed));
+    writeCounter(os, "drishti_captures_total", "Capture requests issued by the trigger.", stats.captures.load(relaxed));
+    writeCounter(os, "drishti_bytes_written_total", "Capture output bytes written.", stats.bytesWritten.load(relaxed));
+    writeCounter(os, "drishti_ingest_bytes_total", "Frame bytes handed to the face tracker.", stats.bytesIngested.load(relaxed));
+    writeCounter(os, "drishti_captures_skipped_total", "Captures dropped by the in-flight budget.", stats.capturesSkipped.load(relaxed));
+    writeCounter(os, "drishti_captures_degraded_total", "Captures reduced to eye crops by the in-flight budget.", stats.capturesDegraded.load(relaxed));
+    writeCounter(os, "drishti_captures_deferred_total", "Frames where trigger() backpressure blocked capture requests.", stats.capturesDeferred.load(relaxed));
+    writeCounter(os, "drishti_captures_moving_total", "Capture candidates gated by face velocity or acceleration.", stats.capturesMoving.load(relaxed));
+    writeCounter(os, "drishti_frames_dropped_total", "Paced playback frames released while the tracker was busy.", stats.framesDropped.load(relaxed));
+    writeCounter(os, "drishti_duplicates_suppressed_total", "Captured frames and eye crops skipped as perceptual duplicates.", stats.duplicatesSuppressed.load(relaxed));
+    writeCounter(os, "drishti_duplicate_bytes_total", "Uncompressed bytes of skipped duplicate captures.", stats.duplicateBytes.load(relaxed));
+    writeCounter(os, "drishti_eyes_rejected_total", "Captured eye crops below the quality threshold.", stats.eyesRejected.load(relaxed));
+    writeGauge(os, "drishti_inflight_bytes", "Capture data copied but not yet processed.", stats.bytesInFlight.load(relaxed));
+    writeGauge(os, "drishti_inflight_bytes_peak", "Peak capture data copied but not yet processed.", stats.peakBytesInFlight.load(relaxed));
+    writeGauge(os, "drishti_fps", "Recent frame rate (smoothed).", stats.getRecentFps());
+    writeGauge(os, "drishti_model_load_seconds", "Time to load the models and create the tracker.", stats.modelLoadTime.load(relaxed));
+
+    const char* name = "drishti_stage_latency_seconds";
+    os << "# HELP " << name << " Frame loop stage latency.\n";
+    os << "# TYPE " << name << " histogram\n";
+    for (int i = 0; i < static_cast<int>(PipelineStage::kCount); i++)
+    {
+        const auto stage = static_cast<PipelineStage>(i);
+        writeHistogram(os, name, std::string("stage=\"") + toString(stage) + "\",", stats[stage]);
+    }
+
+    if (stats.frameLatency.count.load(relaxed))
+    {
+        name = "drishti_frame_latency_seconds";
+        os << "# HELP " << name << " Paced playback latency from the scheduled frame release.\n";
+        os << "# TYPE " << name << " histogram\n";
+        writeHistogram(os, name, std::string(), stats.frameLatency);
+    }
+
+    if (stats.writeLatency.count.load(relaxed))
+    {
+        name = "drishti_write_latency_seconds";
+        os << "# HELP " << name << " Capture output latency from queued to written.\n";
+        os << "# TYPE " << name << " histogram\n";
+        writeHistogram(os, name, std::string(), stats.writeLatency);
+    }
+}
+
+struct MetricsServer::Impl
+{
+    Impl(std::shared_ptr<spdlog::logger>& logger)
+        : logger(logger)
+    {
+    }
+
+    ~Impl()
+    {
+        stop();
+    }
+
+    std::string render() const
+    {
+        std::stringstream ss;
+        writeStats(ss, PipelineStats::get());
+        for (const auto& collector : collectors)
+        {
+            collector(ss);
+        }
+        return ss.str();
+    }
+
+#if defined(DRISHTI_SDK_TEST_HAVE_TCP_SOCKETS)
+    bool start(int port)
+    {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listener < 0)
+        {
+            logger->error("Failed to create metrics socket");
+            return false;
+        }
+
+        int reuse = 1;
+        ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<std::uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // localhost only
+
+        if ((::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) || (::listen(listener, 8) != 0))
+        {
+            logger->error("Failed to bind metrics listener to 127.0.0.1:{}", port);
+            ::close(listener);
+            listener = -1;
+            return false;
+        }
+
+        running = true;
+        thread = std::thread([this] { loop(); });
+        logger->info("Serving metrics on http://127.0.0.1:{}/metrics", port);
+        return true;
+    }
+
+    void stop()
+    {
+        running = false;
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+
+        if (listener >= 0)
+        {
+            ::close(listener);
+            listener = -1;
+        }
+    }
+
+    void loop()
+    {
+        while (running)
+        {
+            pollfd fd{ listener, POLLIN, 0 };
+            if ((::poll(&fd, 1, 100) <= 0) || !(fd.revents & POLLIN))
+            {
+                continue;
+            }
+
+            const int client = ::accept(listener, nullptr, nullptr);
+            if (client >= 0)
+            {
+                serve(client);
+                ::close(client);
+            }
+        }
+    }
+
+    void serve(int client)
+    {
+        // Read the request header (the body, if any, is ignored):
+        std::string request;
+        char data[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+        {
+            pollfd fd{ client, POLLIN, 0 };
+            if (::poll(&fd, 1, 1000) <= 0)
+            {
+                return; // slow or idle client
+            }
+
+            const auto count = ::recv(client, data, sizeof(data), 0);
+            if (count <= 0)
+            {
+                return;
+            }
+            request.append(data, static_cast<std::size_t>(count));
+        }
+
+        std::string status = "200 OK", body;
+        if ((request.compare(0, 13, "GET /metrics ") == 0) || (request.compare(0, 6, "GET / ") == 0))
+        {
+            body = render();
+        }
+        else
+        {
+            status = "404 Not Found";
+            body = "Not found (try /metrics)\n";
+        }
+
+        std::stringstream response;
+        response << "HTTP/1.1 " << status << "\r\n"
+                 << "Content-Type: text/plain; version=0.0.4\r\n"
+                 << "Content-Length: " << body.size() << "\r\n"
+                 << "Connection: close\r\n\r\n"
+                 << body;
+
+        const auto message = response.str();
+        std::size_t offset = 0;
+        while (offset < message.size())
+        {
+            const auto count = ::send(client, message.data() + offset, message.size() - offset, kSendFlags);
+            if (count <= 0)
+            {
+                break;
+            }
+            offset += static_cast<std::size_t>(count);
+        }
+    }
+
+    int listener = -1;
+#else
+    bool start(int port)
+    {
+        logger->error("The metrics listener is not supported on this platform");
+        return false;
+    }
+
+    void stop() {}
+#endif
+
+    std::shared_ptr<spdlog::logger> logger;
+    std::vector<Collector> collectors;
+
+    std::atomic<bool> running{ false };
+    std::thread thread;
+};
+
+MetricsServer::MetricsServer(std::shared_ptr<spdlog::logger>& logger)
+{
+    m_impl = detail::make_unique<Impl>(logger);
+}
+
+MetricsServer::~MetricsServer() = default;
+
+void MetricsServer::add(const Collector& collector)
+{
+    m_impl->collectors.push_back(collector);
+}
+
+bool MetricsServer::start(int port)
+{
+    return m_impl->start(port);
+}
+
+void MetricsServer::stop()
+{
+    m_impl->stop();
+}
+
+std::string MetricsServer::render() const
+{
+    return m_impl->render();
+}
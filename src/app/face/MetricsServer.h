@@ -0,0 +1,47 @@
+/*!
+  @file   MetricsServer.h
+  @author David Hirvonen
+  @brief  Minimal HTTP listener exposing PipelineStats in the Prometheus text format.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  The listener is bound to the loopback interface and serves GET /metrics
+  from its own thread.  It only reads atomic counters, so a scrape never
+  blocks the frame loop.
+
+*/
+
+#ifndef __MetricsServer_h__
+#define __MetricsServer_h__
+
+#include <spdlog/spdlog.h> // for portable logging
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+
+class MetricsServer
+{
+public:
+    // Append additional metrics (exposition format) to the response:
+    using Collector = std::function<void(std::ostream& os)>;
+
+    MetricsServer(std::shared_ptr<spdlog::logger>& logger);
+    ~MetricsServer();
+
+    void add(const Collector& collector);
+
+    bool start(int port);
+    void stop();
+
+    // Render the full exposition (PipelineStats + collectors):
+    std::string render() const;
+
+protected:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+#endif // __MetricsServer_h__
@@ -0,0 +1,138 @@
+/*!
+  @file   MotionGate.cpp
+  @author David Hirvonen
+  @brief  Per-face motion estimation for gating capture requests.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "MotionGate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static float distance2(const MotionGate::Position& a, const MotionGate::Position& b)
+{
+    const float dx = a[0] - b[0];
+    const float dy = a[1] - b[1];
+    const float dz = a[2] - b[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+void MotionGate::Track::push(const Position& p, double t)
+{
+    positions[head] = p;
+    timestamps[head] = t;
+    head = (head + 1) % kHistory;
+    size = std::min(size + 1, static_cast<int>(kHistory));
+}
+
+const MotionGate::Position& MotionGate::Track::position(int age) const
+{
+    return positions[(head + kHistory - 1 - age) % kHistory];
+}
+
+double MotionGate::Track::timestamp(int age) const
+{
+    return timestamps[(head + kHistory - 1 - age) % kHistory];
+}
+
+MotionGate::MotionGate(const Settings& settings)
+    : settings(settings)
+{
+}
+
+void MotionGate::measure(Track& track) const
+{
+    if (track.size < kHistory)
+    {
+        track.still = 0; // no acceleration estimate yet
+        return;
+    }
+
+    const double dt0 = track.timestamp(1) - track.timestamp(2);
+    const double dt1 = track.timestamp(0) - track.timestamp(1);
+
+    // Velocity over the last two intervals and the change between them:
+    std::array<double, 3> v0, v1;
+    double speed = 0.0, acceleration = 0.0;
+    for (int i = 0; i < 3; i++)
+    {
+        v0[i] = (track.position(1)[i] - track.position(2)[i]) / dt0;
+        v1[i] = (track.position(0)[i] - track.position(1)[i]) / dt1;
+        const double a = (v1[i] - v0[i]) / (0.5 * (dt0 + dt1));
+        speed += v1[i] * v1[i];
+        acceleration += a * a;
+    }
+
+    const bool slow = (settings.maxVelocity <= 0.f) || (std::sqrt(speed) < settings.maxVelocity);
+    const bool steady = (settings.maxAcceleration <= 0.f) || (std::sqrt(acceleration) < settings.maxAcceleration);
+    track.still = (slow && steady) ? (track.still + 1) : 0;
+}
+
+void MotionGate::update(const std::vector<Position>& positions, double timestamp)
+{
+    for (auto& track : tracks)
+    {
+        track.seen = false;
+    }
+
+    const float radius2 = settings.radius * settings.radius;
+    for (const auto& p : positions)
+    {
+        // Greedy association with the nearest unclaimed track:
+        Track* best = nullptr;
+        float bestDistance = std::numeric_limits<float>::max();
+        for (auto& track : tracks)
+        {
+            const float d = distance2(track.position(0), p);
+            if (!track.seen && (d < radius2) && (d < bestDistance))
+            {
+                best = &track;
+                bestDistance = d;
+            }
+        }
+
+        if (!best)
+        {
+            tracks.emplace_back();
+            best = &tracks.back();
+        }
+        else if (timestamp <= best->timestamp(0))
+        {
+            best->seen = true; // repeated timestamp (no new information)
+            continue;
+        }
+
+        best->push(p, timestamp);
+        best->seen = true;
+        measure(*best);
+    }
+
+    tracks.erase(std::remove_if(tracks.begin(), tracks.end(), [](const Track& track) { return !track.seen; }), tracks.end());
+}
+
+const MotionGate::Track* MotionGate::find(const Position& position) const
+{
+    const Track* best = nullptr;
+    float bestDistance = std::numeric_limits<float>::max();
+    for (const auto& track : tracks)
+    {
+        const float d = distance2(track.position(0), position);
+        if (d < bestDistance)
+        {
+            best = &track;
+            bestDistance = d;
+        }
+    }
+    return best;
+}
+
+bool MotionGate::isStill(const Position& position) const
+{
+    const auto* track = find(position);
+    return track && (track->still >= std::max(settings.frames, 1));
+}
@@ -0,0 +1,72 @@
+/*!
+  @file   MotionGate.h
+  @author David Hirvonen
+  @brief  Per-face motion estimation for gating capture requests.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  Face positions are associated with tracks (nearest track within a radius)
+  and each track keeps its last few positions in a ring buffer.  Velocity
+  and acceleration are finite differences over the ring, and a face is
+  "still" once both have been under their limits for K consecutive frames.
+  Tracks that aren't seen in a frame are discarded.
+
+*/
+
+#ifndef __MotionGate_h__
+#define __MotionGate_h__
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+class MotionGate
+{
+public:
+    struct Settings
+    {
+        float maxVelocity = 0.f;     // meters/second (0 == unlimited)
+        float maxAcceleration = 0.f; // meters/second^2 (0 == unlimited)
+        int frames = 3;              // K consecutive frames under the limits
+        float radius = 0.1f;         // max motion per frame for track association (meters)
+    };
+
+    using Position = std::array<float, 3>;
+
+    MotionGate(const Settings& settings);
+
+    // Add the face positions for the frame at time timestamp (seconds):
+    void update(const std::vector<Position>& positions, double timestamp);
+
+    // Return true if the face at this position (from the last update) is still:
+    bool isStill(const Position& position) const;
+
+protected:
+    enum
+    {
+        kHistory = 3 // enough for an acceleration estimate
+    };
+
+    struct Track
+    {
+        std::array<Position, kHistory> positions;
+        std::array<double, kHistory> timestamps;
+        int head = 0;  // next slot
+        int size = 0;  // valid samples
+        int still = 0; // consecutive frames under the limits
+        bool seen = false;
+
+        void push(const Position& position, double timestamp);
+        const Position& position(int age) const; // 0 == newest
+        double timestamp(int age) const;
+    };
+
+    void measure(Track& track) const;
+    const Track* find(const Position& position) const;
+
+    Settings settings;
+    std::vector<Track> tracks;
+};
+
+#endif // __MotionGate_h__
@@ -0,0 +1,328 @@
+/*!
+  @file   PipelineComparison.cpp
+  @author David Hirvonen
+  @brief  Run tracker configurations in lockstep and compare speed and results.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "PipelineComparison.h"
+#include "FaceTrackerTest.h"
+#include "FaceTrackerFactoryJson.h"
+#include "FrameIngest.h"
+#include "FrameResult.h"
+#include "PerfReport.h"
+
+#include <aglet/GLContext.h> // for portable opengl context
+
+#include <nlohmann/json.hpp> // nlohman-json
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <ostream>
+
+namespace
+{
+    struct Running
+    {
+        void add(double value)
+        {
+            total += value;
+            max = std::max(max, value);
+            count++;
+        }
+
+        double mean() const { return count ? (total / count) : 0.0; }
+
+        double total = 0.0;
+        double max = 0.0;
+        std::size_t count = 0;
+    };
+
+    // Divergence of one variant from the reference:
+    struct Divergence
+    {
+        std::size_t frames = 0;
+        std::size_t countMismatches = 0;
+        Running position;  // meters
+        Running landmarks; // pixels (mean over points)
+        Running iris;      // pixels (center)
+        Running eyelids;   // pixels (mean over points)
+    };
+
+    struct State
+    {
+        std::string name;
+        std::shared_ptr<drishti::sdk::FaceTracker> tracker;
+        std::unique_ptr<FaceTrackTest> callbacks;
+        std::deque<FrameResult> pending;
+        std::uint64_t received = 0;
+        PerfReport timing;    // tracker call time per frame
+        double elapsed = 0.0; // total tracker call time (seconds)
+        Divergence divergence;
+    };
+
+    // Mean distance between corresponding points (NaN if the models don't correspond):
+    double getPointDelta(const std::vector<cv::Point2f>& a, const std::vector<cv::Point2f>& b)
+    {
+        if (a.empty() || (a.size() != b.size()))
+        {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+
+        double total = 0.0;
+        for (std::size_t i = 0; i < a.size(); i++)
+        {
+            total += cv::norm(a[i] - b[i]);
+        }
+        return total / a.size();
+    }
+
+    double getPositionDelta(const FrameResult::Face& a, const FrameResult::Face& b)
+    {
+        const double dx = a.position[0] - b.position[0];
+        const double dy = a.position[1] - b.position[1];
+        const double dz = a.position[2] - b.position[2];
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    void addIfValid(Running& running, double value, nlohmann::json& record, const char* key)
+    {
+        if (!std::isnan(value))
+        {
+            running.add(value);
+            record[key] = value;
+        }
+    }
+
+    // Compare a frame with the reference and accumulate the divergence:
+    nlohmann::json compare(const FrameResult& reference, const FrameResult& result, Divergence& divergence)
+    {
+        nlohmann::json record = {
+            { "faces", { reference.faces.size(), result.faces.size() } }
+        };
+
+        divergence.frames++;
+        if (reference.faces.size() != result.faces.size())
+        {
+            divergence.countMismatches++;
+        }
+
+        // Greedy nearest face association (the reference drives the matching):
+        std::vector<bool> used(result.faces.size(), false);
+        Running position, landmarks;
+        for (const auto& face : reference.faces)
+        {
+            int best = -1;
+            double bestDelta = std::numeric_limits<double>::max();
+            for (std::size_t i = 0; i < result.faces.size(); i++)
+            {
+                const double delta = getPositionDelta(face, result.faces[i]);
+                if (!used[i] && (delta < bestDelta))
+                {
+                    best = static_cast<int>(i);
+                    bestDelta = delta;
+                }
+            }
+
+            if (best >= 0)
+            {
+                used[best] = true;
+                position.add(bestDelta);
+                const double delta = getPointDelta(face.landmarks, result.faces[best].landmarks);
+                if (!std::isnan(delta))
+                {
+                    landmarks.add(delta);
+                }
+            }
+        }
+
+        if (position.count)
+        {
+            addIfValid(divergence.position, position.mean(), record, "position");
+        }
+        if (landmarks.count)
+        {
+            addIfValid(divergence.landmarks, landmarks.mean(), record, "landmarks");
+        }
+
+        // Eye models (nearest face) correspond by index:
+        if (!reference.eyes.empty() && (reference.eyes.size() == result.eyes.size()))
+        {
+            Running iris, eyelids;
+            for (std::size_t i = 0; i < reference.eyes.size(); i++)
+            {
+                const auto& a = reference.eyes[i];
+                const auto& b = result.eyes[i];
+                iris.add(cv::norm(a.iris.center - b.iris.center));
+                const double delta = getPointDelta(a.eyelids, b.eyelids);
+                if (!std::isnan(delta))
+                {
+                    eyelids.add(delta);
+                }
+            }
+
+            addIfValid(divergence.iris, iris.mean(), record, "iris");
+            if (eyelids.count)
+            {
+                addIfValid(divergence.eyelids, eyelids.mean(), record, "eyelids");
+            }
+        }
+
+        return record;
+    }
+}
+
+PipelineComparison::PipelineComparison(std::shared_ptr<spdlog::logger>& logger, const std::string& models, const cv::Size& size, GLenum textureFormat)
+    : logger(logger)
+    , models(models)
+    , size(size)
+    , textureFormat(textureFormat)
+{
+}
+
+std::size_t PipelineComparison::operator()(const FrameSource& source, const std::vector<Variant>& variants, std::ostream* os)
+{
+    if (variants.size() < 2)
+    {
+        throw std::runtime_error("PipelineComparison: at least two variants are required");
+    }
+
+    // All trackers share this thread's OpenGL context:
+    auto glContext = aglet::GLContext::create(aglet::GLContext::kAuto);
+    if (!glContext)
+    {
+        throw std::runtime_error("PipelineComparison: failed to create an OpenGL context");
+    }
+    (*glContext)();
+
+    std::vector<std::unique_ptr<State>> states;
+    for (const auto& variant : variants)
+    {
+        FaceTrackerFactoryJson factory(models, logger->name());
+
+        std::unique_ptr<State> state(new State);
+        state->name = variant.name;
+        state->tracker = variant.create(factory.factory);
+        if (!state->tracker)
+        {
+            throw std::runtime_error("PipelineComparison: failed to create face tracker " + variant.name);
+        }
+
+        auto* target = state.get();
+        state->callbacks.reset(new FaceTrackTest(logger, std::string()));
+        state->callbacks->setResultHandler([target](const drishti_face_tracker_result_t& faces, double timestamp) {
+            target->pending.emplace_back(target->received++, timestamp, faces);
+        });
+        state->tracker->add(state->callbacks->table);
+        states.push_back(std::move(state));
+    }
+
+    // Source index of each submitted frame that hasn't been compared yet:
+    std::deque<std::size_t> indices;
+
+    const auto submit = [&](cv::Mat& input, bool doTiming) {
+        for (auto& state : states)
+        {
+            drishti::sdk::VideoFrame videoFrame({ input.cols, input.rows }, input.ptr(), true, 0, textureFormat);
+
+            const auto tic = std::chrono::high_resolution_clock::now();
+            (*state->tracker)(videoFrame);
+            const auto toc = std::chrono::high_resolution_clock::now();
+            if (doTiming)
+            {
+                const double seconds = std::chrono::duration<double>(toc - tic).count();
+                state->timing.add(seconds);
+                state->elapsed += seconds;
+            }
+        }
+    };
+
+    // Compare the frames that every variant has produced so far:
+    const auto compareAll = [&]() {
+        auto& baseline = states.front()->pending;
+        while (!indices.empty() && std::all_of(states.begin(), states.end(), [](const std::unique_ptr<State>& state) { return !state->pending.empty(); }))
+        {
+            for (std::size_t i = 1; i < states.size(); i++)
+            {
+                auto record = compare(baseline.front(), states[i]->pending.front(), states[i]->divergence);
+                record["frame"] = indices.front();
+                if (os)
+                {
+                    record["variant"] = states[i]->name;
+                    (*os) << record.dump() << "\n";
+                }
+            }
+
+            for (auto& state : states)
+            {
+                state->pending.pop_front();
+            }
+            indices.pop_front();
+        }
+    };
+
+    cv::Mat image, last;
+    FrameIngest ingest(size);
+    std::size_t frame = 0, index = 0;
+    for (; source(image, index) && !image.empty(); frame++)
+    {
+        cv::Mat& input = ingest(image);
+        indices.push_back(index);
+        submit(input, true);
+        compareAll();
+        last = input;
+    }
+
+    // The tracker output lags its input, so push the last frame again (untimed)
+    // until every variant has caught up (the extra results aren't compared):
+    static const int kDrainFrames = 8;
+    for (int i = 0; (i < kDrainFrames) && !indices.empty() && !last.empty(); i++)
+    {
+        submit(last, false);
+        compareAll();
+    }
+    if (!indices.empty())
+    {
+        logger->warn("compare: {} frames were not produced by every variant", indices.size());
+    }
+
+    // Summary:
+    const auto& reference = states.front()->name;
+    for (const auto& state : states)
+    {
+        const auto& timing = state->timing;
+        logger->info(
+            "compare {}: {} frames in {:.3f} seconds ({:.2f} fps), latency p50 {:.2f} p90 {:.2f} p99 {:.2f} ms",
+            state->name,
+            frame,
+            state->elapsed,
+            (state->elapsed > 0.0) ? (frame / state->elapsed) : 0.0,
+            timing.getPercentile(0.50) * 1e3,
+            timing.getPercentile(0.90) * 1e3,
+            timing.getPercentile(0.99) * 1e3);
+    }
+
+    for (std::size_t i = 1; i < states.size(); i++)
+    {
+        const auto& d = states[i]->divergence;
+        logger->info(
+            "compare {} vs {}: {} frames, {} face count mismatches ({:.2f}%)",
+            states[i]->name,
+            reference,
+            d.frames,
+            d.countMismatches,
+            d.frames ? (100.0 * d.countMismatches / d.frames) : 0.0);
+        logger->info("  position (m): mean {:.4f} max {:.4f}", d.position.mean(), d.position.max);
+        logger->info("  landmarks (px): mean {:.2f} max {:.2f}", d.landmarks.mean(), d.landmarks.max);
+        logger->info("  iris (px): mean {:.2f} max {:.2f}", d.iris.mean(), d.iris.max);
+        logger->info("  eyelids (px): mean {:.2f} max {:.2f}", d.eyelids.mean(), d.eyelids.max);
+    }
+
+    return frame;
+}
@@ -0,0 +1,68 @@
+/*!
+  @file   PipelineComparison.h
+  @author David Hirvonen
+  @brief  Run tracker configurations in lockstep and compare speed and results.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  Each decoded frame is passed to every configured tracker in turn (on one
+  thread with one OpenGL context), so all variants see identical input.  The
+  tracker calls are timed per variant, and the results of each variant are
+  compared with the first (reference) variant.  Results are matched in
+  arrival order, so pipelines with different output latency still compare
+  the same frames, and the last frame is re-submitted at the end until every
+  variant has produced a result for each source frame:
+
+  - face count mismatches
+  - face position deltas (meters) and landmark deltas (pixels)
+  - iris center and eyelid deltas (eye crop pixels)
+
+*/
+
+#ifndef __PipelineComparison_h__
+#define __PipelineComparison_h__
+
+#include <drishti/FaceTracker.hpp>
+
+#include <opencv2/highgui.hpp>
+
+#include <spdlog/spdlog.h> // for portable logging
+
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+class PipelineComparison
+{
+public:
+    using TrackerFactory = std::function<std::shared_ptr<drishti::sdk::FaceTracker>(drishti::sdk::FaceTracker::Resources& resources)>;
+
+    struct Variant
+    {
+        std::string name;
+        TrackerFactory create;
+    };
+
+    // Frames are resized to the specified tracker size on ingest (if needed):
+    PipelineComparison(std::shared_ptr<spdlog::logger>& logger, const std::string& models, const cv::Size& size, GLenum textureFormat);
+
+    // Reads the next frame and its source index, returns false at the end
+    // (frame selection, i.e., start/stride/end, is up to the source):
+    using FrameSource = std::function<bool(cv::Mat& image, std::size_t& index)>;
+
+    // Process the frames from source and log the summary, the per-frame
+    // divergence is written to os as JSON lines (optional).  Returns the number
+    // of frames processed:
+    std::size_t operator()(const FrameSource& source, const std::vector<Variant>& variants, std::ostream* os);
+
+protected:
+    std::shared_ptr<spdlog::logger> logger;
+    std::string models;
+    cv::Size size;
+    GLenum textureFormat;
+};
+
+#endif // __PipelineComparison_h__
@@ -0,0 +1,36 @@
+/*!
+  @file   PipelineStage.cpp
+  @author David Hirvonen
+  @brief  Named stages of the face tracking frame loop (for instrumentation).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "PipelineStage.h"
+#include "PipelineStats.h"
+#include "FrameTrace.h"
+#include "AllocationTracker.h"
+
+ScopedStage::ScopedStage(PipelineStage stage)
+    : stage(stage)
+    , begin(FrameTrace::get().now())
+    , previous(AllocationTracker::enter(stage))
+    , hasCounters(HardwareCounters::read(counters))
+{
+}
+
+ScopedStage::~ScopedStage()
+{
+    auto& trace = FrameTrace::get();
+    const auto end = trace.now();
+    trace.record(toString(stage), FrameTrace::getFrame(), begin, end);
+    PipelineStats::get()[stage].add(static_cast<std::uint64_t>(end - begin));
+    AllocationTracker::leave(previous);
+
+    if (hasCounters)
+    {
+        HardwareCounters::add(stage, counters);
+    }
+}
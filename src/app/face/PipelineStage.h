@@ -0,0 +1,54 @@
+/*!
+  @file   PipelineStage.h
+  @author David Hirvonen
+  @brief  Named stages of the face tracking frame loop (for instrumentation).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#ifndef __PipelineStage_h__
+#define __PipelineStage_h__
+
+#include "HardwareCounters.h"
+
+#include <cstdint>
+
+enum class PipelineStage
+{
+    kRead,      // video source read + decode
+    kConvert,   // color conversion to the texture format
+    kTrack,     // drishti::sdk::FaceTracker::operator()
+    kTrigger,   // FaceTrackTest::trigger()
+    kCallback,  // FaceTrackTest::callback()
+    kAllocator, // FaceTrackTest::allocator()
+    kPost,      // AsyncWorker::post() (blocks only while the job queue is full)
+    kProcess,   // FaceTrackTest::process() on the worker thread
+    kRefine,    // EyeRefiner (EyeSegmenter) on an eye crop, on a pool thread
+    kCount
+};
+
+inline const char* toString(PipelineStage stage)
+{
+    static const char* names[] = { "read", "convert", "track", "trigger", "callback", "allocator", "post", "process", "refine" };
+    return names[static_cast<int>(stage)];
+}
+
+// Instrument the enclosing scope as one stage of the current frame, the
+// span is recorded in the FrameTrace and timed in the PipelineStats:
+class ScopedStage
+{
+public:
+    ScopedStage(PipelineStage stage);
+    ~ScopedStage();
+
+protected:
+    PipelineStage stage;
+    std::int64_t begin;
+    int previous; // enclosing stage (allocation tracking)
+    HardwareCounters::Sample counters; // at entry
+    bool hasCounters;
+};
+
+#endif // __PipelineStage_h__
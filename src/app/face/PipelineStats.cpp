@@ -0,0 +1,179 @@
+/*!
+  @file   PipelineStats.cpp
+  @author David Hirvonen
+  @brief  Lock-free runtime statistics for the face tracking frame loop.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "PipelineStats.h"
+#include "AllocationTracker.h"
+#include "HardwareCounters.h"
+
+#include <algorithm>
+#include <ostream>
+
+// clang-format off
+const std::array<std::uint64_t, PipelineStats::Latency::kBounds> PipelineStats::Latency::bounds
+{{
+    500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000
+}};
+// clang-format on
+
+void PipelineStats::Latency::add(std::uint64_t microseconds)
+{
+    std::size_t bucket = 0;
+    while ((bucket < bounds.size()) && (microseconds > bounds[bucket]))
+    {
+        bucket++;
+    }
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    count.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(microseconds, std::memory_order_relaxed);
+
+    auto current = max.load(std::memory_order_relaxed);
+    while ((microseconds > current) && !max.compare_exchange_weak(current, microseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+double PipelineStats::Latency::getPercentile(double p) const
+{
+    std::array<std::uint64_t, kBounds + 1> counts;
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < counts.size(); i++)
+    {
+        total += (counts[i] = buckets[i].load(std::memory_order_relaxed));
+    }
+    if (total == 0)
+    {
+        return 0.0;
+    }
+
+    const double upper = static_cast<double>(max.load(std::memory_order_relaxed));
+    const double rank = std::min(std::max(p, 0.0), 1.0) * static_cast<double>(total);
+
+    double cumulative = 0.0;
+    for (std::size_t i = 0; i < counts.size(); i++)
+    {
+        if (counts[i] && ((cumulative + counts[i]) >= rank))
+        {
+            const double lo = (i > 0) ? static_cast<double>(bounds[i - 1]) : 0.0;
+            const double hi = (i < bounds.size()) ? std::min(static_cast<double>(bounds[i]), upper) : upper;
+            return lo + (hi - lo) * (rank - cumulative) / counts[i];
+        }
+        cumulative += counts[i];
+    }
+    return upper;
+}
+
+PipelineStats& PipelineStats::get()
+{
+    static PipelineStats stats;
+    return stats;
+}
+
+PipelineStats::PipelineStats()
+    : start(std::chrono::steady_clock::now())
+{
+}
+
+void PipelineStats::addFrame()
+{
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const auto now = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    const auto last = lastFrame.exchange(now, std::memory_order_relaxed);
+
+    if (frames.fetch_add(1, std::memory_order_relaxed) > 0)
+    {
+        const double period = static_cast<double>(now - last) * 1e-6;
+        const double smoothed = framePeriod.load(std::memory_order_relaxed);
+        framePeriod.store((smoothed > 0.0) ? (0.9 * smoothed + 0.1 * period) : period, std::memory_order_relaxed);
+    }
+}
+
+double PipelineStats::getFps() const
+{
+    const auto elapsed = static_cast<double>(lastFrame.load(std::memory_order_relaxed)) * 1e-6;
+    return (elapsed > 0.0) ? static_cast<double>(frames.load(std::memory_order_relaxed)) / elapsed : 0.0;
+}
+
+double PipelineStats::getRecentFps() const
+{
+    const double period = framePeriod.load(std::memory_order_relaxed);
+    return (period > 0.0) ? (1.0 / period) : 0.0;
+}
+
+void PipelineStats::addInFlight(std::uint64_t bytes)
+{
+    const auto total = bytesInFlight.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    auto current = peakBytesInFlight.load(std::memory_order_relaxed);
+    while ((total > current) && !peakBytesInFlight.compare_exchange_weak(current, total, std::memory_order_relaxed))
+    {
+    }
+}
+
+void PipelineStats::removeInFlight(std::uint64_t bytes)
+{
+    bytesInFlight.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void PipelineStats::report(std::ostream& os) const
+{
+    os << "frames " << frames.load(std::memory_order_relaxed) << "\n";
+    os << "fps " << getFps() << "\n";
+    os << "fps.recent " << getRecentFps() << "\n";
+    os << "captures " << captures.load(std::memory_order_relaxed) << "\n";
+    os << "callbacks " << callbacks.load(std::memory_order_relaxed) << "\n";
+    os << "bytes_written " << bytesWritten.load(std::memory_order_relaxed) << "\n";
+    os << "inflight_bytes " << bytesInFlight.load(std::memory_order_relaxed) << "\n";
+    os << "inflight_bytes.peak " << peakBytesInFlight.load(std::memory_order_relaxed) << "\n";
+    os << "captures.skipped " << capturesSkipped.load(std::memory_order_relaxed) << "\n";
+    os << "captures.degraded " << capturesDegraded.load(std::memory_order_relaxed) << "\n";
+    os << "captures.deferred " << capturesDeferred.load(std::memory_order_relaxed) << "\n";
+    os << "captures.moving " << capturesMoving.load(std::memory_order_relaxed) << "\n";
+    os << "frames.dropped " << framesDropped.load(std::memory_order_relaxed) << "\n";
+    os << "duplicates.suppressed " << duplicatesSuppressed.load(std::memory_order_relaxed) << "\n";
+    os << "duplicates.bytes_saved " << duplicateBytes.load(std::memory_order_relaxed) << "\n";
+    os << "eyes.rejected " << eyesRejected.load(std::memory_order_relaxed) << "\n";
+    {
+        const auto count = frames.load(std::memory_order_relaxed);
+        const auto bytes = bytesIngested.load(std::memory_order_relaxed);
+        os << "ingest_bytes_per_frame " << (count ? (bytes / count) : 0) << "\n";
+    }
+    os << "model_load_seconds " << modelLoadTime.load(std::memory_order_relaxed) << "\n";
+    if (const auto count = frameLatency.count.load(std::memory_order_relaxed))
+    {
+        const auto total = frameLatency.total.load(std::memory_order_relaxed);
+        const auto max = frameLatency.max.load(std::memory_order_relaxed);
+        os << "frame_latency.mean_ms " << (static_cast<double>(total) * 1e-3 / count) << "\n";
+        os << "frame_latency.max_ms " << (static_cast<double>(max) * 1e-3) << "\n";
+    }
+    if (const auto count = writeLatency.count.load(std::memory_order_relaxed))
+    {
+        const auto total = writeLatency.total.load(std::memory_order_relaxed);
+        const auto max = writeLatency.max.load(std::memory_order_relaxed);
+        os << "write_latency.mean_ms " << (static_cast<double>(total) * 1e-3 / count) << "\n";
+        os << "write_latency.max_ms " << (static_cast<double>(max) * 1e-3) << "\n";
+    }
+
+    for (int i = 0; i < static_cast<int>(PipelineStage::kCount); i++)
+    {
+        const auto& latency = stages[i];
+        const auto count = latency.count.load(std::memory_order_relaxed);
+        const auto total = latency.total.load(std::memory_order_relaxed);
+        const auto max = latency.max.load(std::memory_order_relaxed);
+        const char* name = toString(static_cast<PipelineStage>(i));
+
+        os << "stage." << name << ".count " << count << "\n";
+        os << "stage." << name << ".mean_ms " << (count ? (static_cast<double>(total) * 1e-3 / count) : 0.0) << "\n";
+        os << "stage." << name << ".max_ms " << (static_cast<double>(max) * 1e-3) << "\n";
+    }
+
+    AllocationTracker::report(os);
+    HardwareCounters::report(os);
+}
@@ -0,0 +1,91 @@
+/*!
+  @file   PipelineStats.h
+  @author David Hirvonen
+  @brief  Lock-free runtime statistics for the face tracking frame loop.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#ifndef __PipelineStats_h__
+#define __PipelineStats_h__
+
+#include "PipelineStage.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+// Counters are written from the frame loop and worker threads with relaxed
+// atomics and can be read at any time from a monitoring thread.
+class PipelineStats
+{
+public:
+    struct Latency
+    {
+        // Histogram bucket upper bounds (microseconds), the last bucket is +Inf:
+        static const std::size_t kBounds = 11;
+        static const std::array<std::uint64_t, kBounds> bounds;
+
+        void add(std::uint64_t microseconds);
+
+        // Estimate from the histogram (linear within a bucket, capped at max):
+        double getPercentile(double p) const; // microseconds
+
+        std::atomic<std::uint64_t> count{ 0 };
+        std::atomic<std::uint64_t> total{ 0 }; // microseconds
+        std::atomic<std::uint64_t> max{ 0 };   // microseconds
+        std::array<std::atomic<std::uint64_t>, kBounds + 1> buckets{};
+    };
+
+    static PipelineStats& get();
+
+    Latency& operator[](PipelineStage stage) { return stages[static_cast<int>(stage)]; }
+    const Latency& operator[](PipelineStage stage) const { return stages[static_cast<int>(stage)]; }
+
+    // Called once per frame from the frame loop:
+    void addFrame();
+
+    // Capture data that has been copied but not yet processed:
+    void addInFlight(std::uint64_t bytes);
+    void removeInFlight(std::uint64_t bytes);
+
+    double getFps() const;       // average over the full run
+    double getRecentFps() const; // exponential moving average
+
+    // Write "key value" lines:
+    void report(std::ostream& os) const;
+
+    std::atomic<std::uint64_t> frames{ 0 };
+    std::atomic<std::uint64_t> captures{ 0 };  // capture requests issued by trigger()
+    std::atomic<std::uint64_t> callbacks{ 0 }; // callbacks with results
+    std::atomic<std::uint64_t> bytesWritten{ 0 }; // capture output
+    std::atomic<std::uint64_t> bytesIngested{ 0 }; // frame data handed to the tracker
+    std::atomic<std::uint64_t> bytesInFlight{ 0 };     // capture copies waiting for process()
+    std::atomic<std::uint64_t> peakBytesInFlight{ 0 };
+    std::atomic<std::uint64_t> capturesSkipped{ 0 };  // over budget: dropped
+    std::atomic<std::uint64_t> capturesDegraded{ 0 }; // over budget: eye crops only
+    std::atomic<std::uint64_t> capturesDeferred{ 0 }; // over budget: frames w/o capture requests
+    std::atomic<std::uint64_t> capturesMoving{ 0 };   // motion gate: faces in range but moving
+    std::atomic<std::uint64_t> framesDropped{ 0 };    // paced playback: released while the tracker was busy
+    std::atomic<std::uint64_t> duplicatesSuppressed{ 0 }; // dedupe: frames/eye crops not written
+    std::atomic<std::uint64_t> duplicateBytes{ 0 };       // dedupe: uncompressed bytes not written
+    std::atomic<std::uint64_t> eyesRejected{ 0 };         // quality gate: eye crops not written
+    std::atomic<double> modelLoadTime{ 0.0 };     // seconds
+    Latency frameLatency; // paced playback: scheduled release to tracker output
+    Latency writeLatency; // CaptureWriter: queued to written
+
+protected:
+    PipelineStats();
+
+    std::array<Latency, static_cast<int>(PipelineStage::kCount)> stages;
+
+    std::chrono::steady_clock::time_point start;
+    std::atomic<std::int64_t> lastFrame{ 0 }; // microseconds since start
+    std::atomic<double> framePeriod{ 0.0 };   // seconds (smoothed)
+};
+
+#endif // __PipelineStats_h__
@@ -0,0 +1,188 @@
+/*!
+  @file   SegmentRunner.cpp
+  @author David Hirvonen
+  @brief  Process a long video as N concurrent time segments (one tracker each).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "SegmentRunner.h"
+#include "FaceTrackerTest.h"
+#include "FaceTrackerFactoryJson.h"
+#include "FrameIngest.h"
+#include "ThreadTopology.h"
+
+#include <aglet/GLContext.h> // for portable opengl context
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <thread>
+
+// Upper bound on the tracker output latency (frames):
+static const int kDrainFrames = 8;
+
+SegmentRunner::SegmentRunner(std::shared_ptr<spdlog::logger>& logger, const std::string& input, const std::string& models, const cv::Size& size, GLenum textureFormat)
+    : logger(logger)
+    , input(input)
+    , models(models)
+    , size(size)
+    , textureFormat(textureFormat)
+{
+}
+
+std::vector<SegmentRunner::Segment> SegmentRunner::split(std::size_t frames, std::size_t count, std::size_t warmup)
+{
+    count = std::max(std::min(count, frames), std::size_t(1));
+
+    std::vector<Segment> segments;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const std::size_t begin = (frames * i) / count;
+        const std::size_t end = (frames * (i + 1)) / count;
+        segments.push_back({ begin, end, std::min(begin, warmup) });
+    }
+    return segments;
+}
+
+std::vector<FrameResult> SegmentRunner::operator()(const std::vector<Segment>& segments, const TrackerFactory& create)
+{
+    std::vector<std::vector<FrameResult>> results(segments.size());
+    std::vector<std::exception_ptr> errors(segments.size());
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < segments.size(); i++)
+    {
+        workers.emplace_back([&, i]() {
+            ThreadTopology::get().apply("segment");
+            try
+            {
+                process(segments[i], create, results[i]);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    for (const auto& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Segments are contiguous and each one is ordered, so stitching is a concatenation:
+    std::vector<FrameResult> stitched;
+    for (auto& segment : results)
+    {
+        std::move(segment.begin(), segment.end(), std::back_inserter(stitched));
+    }
+    return stitched;
+}
+
+void SegmentRunner::process(const Segment& segment, const TrackerFactory& create, std::vector<FrameResult>& results)
+{
+    const auto tic = std::chrono::high_resolution_clock::now();
+
+    // Each worker needs its own (current) OpenGL context for its tracker:
+    auto glContext = aglet::GLContext::create(aglet::GLContext::kAuto);
+    if (!glContext)
+    {
+        throw std::runtime_error("SegmentRunner: failed to create an OpenGL context for the worker thread");
+    }
+    (*glContext)();
+
+    FaceTrackerFactoryJson factory(models, logger->name());
+    auto tracker = create(factory.factory);
+    if (!tracker)
+    {
+        throw std::runtime_error("SegmentRunner: failed to create face tracker");
+    }
+
+    const std::size_t first = segment.begin - segment.warmup;
+
+    // The tracker output can lag its input by a few frames, so results are
+    // matched to the submitted frames in order (rather than tagged with the
+    // frame that is being submitted when the callback fires):
+    std::deque<std::uint64_t> submitted;
+    FaceTrackTest callbacks(logger, std::string());
+    callbacks.setResultHandler([&](const drishti_face_tracker_result_t& faces, double timestamp) {
+        if (submitted.empty())
+        {
+            return; // output for a drain frame
+        }
+
+        const auto index = submitted.front();
+        submitted.pop_front();
+        if (index >= segment.begin)
+        {
+            results.emplace_back(index, timestamp, faces);
+        }
+    });
+    tracker->add(callbacks.table);
+
+    cv::VideoCapture video(input);
+    if (!video.isOpened())
+    {
+        throw std::runtime_error("SegmentRunner: failed to open " + input);
+    }
+
+    // Seek to the start of the warm-up interval, with a sequential fallback
+    // for sources that don't support random access:
+    if ((first > 0) && !video.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(first)))
+    {
+        for (std::size_t i = 0; (i < first) && video.grab(); i++)
+        {
+        }
+    }
+
+    cv::Mat image, last;
+    FrameIngest ingest(size);
+    std::uint64_t frame = first;
+    for (; frame < segment.end; frame++)
+    {
+        if (!video.read(image) || image.empty())
+        {
+            logger->warn("Segment [{},{}) ended early at frame {}", segment.begin, segment.end, frame);
+            break;
+        }
+
+        cv::Mat& input = ingest(image);
+        drishti::sdk::VideoFrame videoFrame({ input.cols, input.rows }, input.ptr(), true, 0, textureFormat);
+        submitted.push_back(frame);
+        (*tracker)(videoFrame);
+        last = input;
+    }
+
+    // Drain the results still in the tracker pipeline by repeating the last
+    // frame (the output for the repeated frames is discarded):
+    for (int i = 0; (i < kDrainFrames) && !submitted.empty() && !last.empty(); i++)
+    {
+        drishti::sdk::VideoFrame videoFrame({ last.cols, last.rows }, last.ptr(), true, 0, textureFormat);
+        (*tracker)(videoFrame);
+    }
+    if (!submitted.empty())
+    {
+        logger->warn("Segment [{},{}) is missing results for {} frames", segment.begin, segment.end, submitted.size());
+    }
+
+    const auto toc = std::chrono::high_resolution_clock::now();
+    const double elapsed = std::chrono::duration<double>(toc - tic).count();
+    const auto processed = frame - first;
+    logger->info("Segment [{},{}) warmup {}: {} frames in {} seconds ({} fps)", segment.begin, segment.end, segment.warmup, processed, elapsed, processed / elapsed);
+}
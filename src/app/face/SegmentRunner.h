@@ -0,0 +1,61 @@
+/*!
+  @file   SegmentRunner.h
+  @author David Hirvonen
+  @brief  Process a long video as N concurrent time segments (one tracker each).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  Each segment starts decoding a number of warm-up frames before its first
+  output frame, so that tracks can be (re)initialized (see minTrackHits)
+  before results are kept.  The warm-up results are discarded and the
+  segments are stitched back together in frame order.
+
+*/
+
+#ifndef __SegmentRunner_h__
+#define __SegmentRunner_h__
+
+#include "FrameResult.h"
+
+#include <drishti/FaceTracker.hpp>
+
+#include <spdlog/spdlog.h> // for portable logging
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class SegmentRunner
+{
+public:
+    using TrackerFactory = std::function<std::shared_ptr<drishti::sdk::FaceTracker>(drishti::sdk::FaceTracker::Resources& resources)>;
+
+    struct Segment
+    {
+        std::size_t begin;  // first output frame
+        std::size_t end;    // one past the last output frame
+        std::size_t warmup; // frames processed before begin (results discarded)
+    };
+
+    // Frames are resized to the specified tracker size on ingest (if needed):
+    SegmentRunner(std::shared_ptr<spdlog::logger>& logger, const std::string& input, const std::string& models, const cv::Size& size, GLenum textureFormat);
+
+    // Split [0, frames) into contiguous segments of (nearly) equal length:
+    static std::vector<Segment> split(std::size_t frames, std::size_t count, std::size_t warmup);
+
+    // Run all segments concurrently and return the stitched results in frame order:
+    std::vector<FrameResult> operator()(const std::vector<Segment>& segments, const TrackerFactory& create);
+
+protected:
+    void process(const Segment& segment, const TrackerFactory& create, std::vector<FrameResult>& results);
+
+    std::shared_ptr<spdlog::logger> logger;
+    std::string input;
+    std::string models;
+    cv::Size size;
+    GLenum textureFormat;
+};
+
+#endif // __SegmentRunner_h__
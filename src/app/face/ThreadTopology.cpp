@@ -0,0 +1,152 @@
+/*!
+  @file   ThreadTopology.cpp
+  @author David Hirvonen
+  @brief  Per role CPU affinity, priority and pool size for application threads.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "ThreadTopology.h"
+
+#include <nlohmann/json.hpp> // nlohman-json
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+// clang-format off
+#if defined(__linux__)
+#  define DRISHTI_SDK_TEST_HAVE_AFFINITY 1
+#  include <pthread.h>
+#  include <sched.h>
+#  include <sys/resource.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+// clang-format on
+
+static const char* kRoles[] = { "tracker", "writer", "refine", "segment", "capture" };
+
+ThreadTopology& ThreadTopology::get()
+{
+    static ThreadTopology topology;
+    return topology;
+}
+
+void ThreadTopology::setLogger(const std::shared_ptr<spdlog::logger>& logger)
+{
+    this->logger = logger;
+}
+
+void ThreadTopology::load(const std::string& filename)
+{
+    std::ifstream ifs(filename);
+    if (!ifs)
+    {
+        throw std::runtime_error("ThreadTopology::load() failed to open " + filename);
+    }
+
+    nlohmann::json json;
+    ifs >> json;
+
+    if (!json.count("threads"))
+    {
+        return;
+    }
+
+    for (auto iter = json["threads"].begin(); iter != json["threads"].end(); ++iter)
+    {
+        if (std::find(std::begin(kRoles), std::end(kRoles), iter.key()) == std::end(kRoles))
+        {
+            throw std::runtime_error("ThreadTopology::load() unknown thread role " + iter.key());
+        }
+
+        const auto& value = iter.value();
+
+        Role role;
+        if (value.count("cpus"))
+        {
+            role.cpus = value["cpus"].get<std::vector<int>>();
+        }
+        if (value.count("priority"))
+        {
+            role.priority = value["priority"].get<int>();
+            role.hasPriority = true;
+        }
+        if (value.count("size"))
+        {
+            role.size = value["size"].get<std::size_t>();
+        }
+        roles[iter.key()] = role;
+    }
+}
+
+std::size_t ThreadTopology::getSize(const std::string& role, std::size_t fallback) const
+{
+    const auto iter = roles.find(role);
+    return ((iter != roles.end()) && iter->second.size) ? iter->second.size : fallback;
+}
+
+void ThreadTopology::apply(const std::string& name)
+{
+    const auto iter = roles.find(name);
+    if (iter == roles.end())
+    {
+        return;
+    }
+
+    const auto& role = iter->second;
+
+#if defined(DRISHTI_SDK_TEST_HAVE_AFFINITY)
+    if (!role.cpus.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (const auto& cpu : role.cpus)
+        {
+            CPU_SET(cpu, &cpus);
+        }
+        if ((pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) && logger)
+        {
+            logger->warn("Failed to set the CPU affinity for thread role {}", name);
+        }
+    }
+
+    // The nice value is per thread on linux:
+    const auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+    if (role.hasPriority && (::setpriority(PRIO_PROCESS, tid, role.priority) != 0) && logger)
+    {
+        logger->warn("Failed to set priority {} for thread role {} (requires CAP_SYS_NICE to raise)", role.priority, name);
+    }
+
+    if (logger)
+    {
+        // Report what the kernel actually applied:
+        std::stringstream ss;
+        cpu_set_t applied;
+        CPU_ZERO(&applied);
+        if (pthread_getaffinity_np(pthread_self(), sizeof(applied), &applied) == 0)
+        {
+            const char* separator = "";
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            {
+                if (CPU_ISSET(cpu, &applied))
+                {
+                    ss << separator << cpu;
+                    separator = ",";
+                }
+            }
+        }
+        logger->info("Thread role {} (tid {}): cpus [{}] nice {}", name, tid, ss.str(), ::getpriority(PRIO_PROCESS, tid));
+    }
+#else
+    if (logger)
+    {
+        logger->warn("Thread affinity is not supported on this platform (role {})", name);
+    }
+#endif
+}
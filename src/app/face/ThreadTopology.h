@@ -0,0 +1,68 @@
+/*!
+  @file   ThreadTopology.h
+  @author David Hirvonen
+  @brief  Per role CPU affinity, priority and pool size for application threads.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  The optional "threads" section of the JSON configuration names each role:
+
+  "threads" :
+  {
+      "tracker" : { "cpus" : [0, 1], "priority" : -5 },
+      "writer" : { "cpus" : [2] },
+      "refine" : { "cpus" : [4, 5, 6, 7], "size" : 4 }
+  }
+
+  Roles: tracker (GL thread: tracking + preview), writer (capture worker and
+  CaptureWriter output threads, the size is the pwrite pool size),
+  refine (eye refinement pool), segment (segment workers) and capture (video
+  source thread).  The priority is a nice value (-20..19).  Threads created by
+  the SDK inherit the affinity of the tracker thread that creates them.
+
+*/
+
+#ifndef __ThreadTopology_h__
+#define __ThreadTopology_h__
+
+#include <spdlog/spdlog.h> // for portable logging
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ThreadTopology
+{
+public:
+    struct Role
+    {
+        std::vector<int> cpus; // empty == any
+        int priority = 0;
+        bool hasPriority = false;
+        std::size_t size = 0; // pool size (0 == default)
+    };
+
+    static ThreadTopology& get();
+
+    // Load the "threads" section (if present) from a JSON configuration file:
+    void load(const std::string& filename);
+
+    void setLogger(const std::shared_ptr<spdlog::logger>& logger);
+
+    // Apply a role to the calling thread (at thread creation) and report the
+    // affinity that was actually applied, roles without settings are ignored:
+    void apply(const std::string& role);
+
+    // Pool size for a role (or the fallback if it isn't configured):
+    std::size_t getSize(const std::string& role, std::size_t fallback) const;
+
+protected:
+    ThreadTopology() = default;
+
+    std::map<std::string, Role> roles;
+    std::shared_ptr<spdlog::logger> logger;
+};
+
+#endif // __ThreadTopology_h__
@@ -1,23 +1,14 @@
 #include "VideoCaptureList.h"
 
+#include <boost/filesystem.hpp> // for portable path (de)construction
+#include <boost/version.hpp>
+
+#include <algorithm>
+#include <cctype>
 #include <fstream>
-#include <istream>
-#include <iterator>
 #include <memory>
 
-// https://stackoverflow.com/a/1567703
-class Line
-{
-    std::string data;
-
-public:
-    friend std::istream& operator>>(std::istream& is, Line& l)
-    {
-        std::getline(is, l.data);
-        return is;
-    }
-    operator std::string() const { return data; }
-};
+namespace bfs = boost::filesystem;
 
 namespace detail
 {
@@ -28,58 +19,321 @@ namespace detail
     }
 }
 
-static void expand(const std::string& filename, std::vector<std::string>& filenames)
+// URLs (rtsp://host/stream?token=...) are passed through to the video backend:
+static bool hasWildcards(const std::string& filename)
 {
-    // Create input file list (or single image)
-    filenames = { filename };
-    if (filename.find(".txt") != std::string::npos)
+    return (filename.find("://") == std::string::npos) && (filename.find_first_of("*?") != std::string::npos);
+}
+
+// Match a filename against a pattern with * and ? wildcards:
+static bool match(const char* pattern, const char* text)
+{
+    const char* star = nullptr; // last * in the pattern
+    const char* resume = nullptr;
+    while (*text)
     {
-        std::ifstream ifs(filename);
-        if (ifs)
+        if ((*pattern == '?') || (*pattern == *text))
+        {
+            pattern++;
+            text++;
+        }
+        else if (*pattern == '*')
+        {
+            star = pattern++;
+            resume = text;
+        }
+        else if (star)
         {
-            filenames.clear();
-            std::copy(std::istream_iterator<Line>(ifs), std::istream_iterator<Line>(), std::back_inserter(filenames));
+            pattern = star + 1;
+            text = ++resume;
         }
         else
+        {
+            return false;
+        }
+    }
+
+    while (*pattern == '*')
+    {
+        pattern++;
+    }
+    return *pattern == 0;
+}
+
+static bool isImage(const bfs::path& path)
+{
+    static const char* extensions[] = { ".bmp", ".jpeg", ".jpg", ".pgm", ".png", ".ppm", ".tif", ".tiff", ".webp" };
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return std::find(std::begin(extensions), std::end(extensions), extension) != std::end(extensions);
+}
+
+// Filename sources: {
+
+struct Cursor
+{
+    virtual ~Cursor() = default;
+    virtual bool next(std::string& filename) = 0;
+    virtual void rewind() = 0;
+};
+
+// An explicit list of files (or a single image):
+struct VectorCursor : public Cursor
+{
+    VectorCursor(const std::vector<std::string>& filenames)
+        : filenames(filenames)
+    {
+    }
+
+    bool next(std::string& filename) override
+    {
+        if (index < filenames.size())
+        {
+            filename = filenames[index++];
+            return true;
+        }
+        return false;
+    }
+
+    void rewind() override
+    {
+        index = 0;
+    }
+
+    std::vector<std::string> filenames;
+    std::size_t index = 0;
+};
+
+// One path per line, read incrementally (blank lines are skipped):
+struct FileCursor : public Cursor
+{
+    FileCursor(const std::string& filename)
+        : ifs(filename)
+    {
+        if (!ifs)
         {
             throw std::runtime_error("Unable to open file: " + filename);
         }
     }
+
+    bool next(std::string& filename) override
+    {
+        while (std::getline(ifs, filename))
+        {
+            if (!filename.empty() && (filename.back() == '\r'))
+            {
+                filename.pop_back();
+            }
+            if (!filename.empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void rewind() override
+    {
+        ifs.clear();
+        ifs.seekg(0);
+    }
+
+    std::ifstream ifs;
+};
+
+// Don't descend into a directory that can't be opened:
+static void skip(bfs::recursive_directory_iterator& iter)
+{
+#if BOOST_VERSION >= 107200
+    iter.disable_recursion_pending();
+#else
+    iter.no_push();
+#endif
+}
+
+// A failed read ends a flat directory listing (there is nothing to step past):
+static void skip(bfs::directory_iterator& iter)
+{
+    iter = bfs::directory_iterator();
+}
+
+// Regular files in a directory (recursive) or matching a pattern (top level only):
+template <typename Iterator>
+struct DirectoryCursor : public Cursor
+{
+    DirectoryCursor(const bfs::path& directory, const std::string& pattern, std::shared_ptr<spdlog::logger> logger)
+        : directory(directory)
+        , pattern(pattern)
+        , logger(logger)
+    {
+        if (!bfs::is_directory(directory))
+        {
+            throw std::runtime_error("Unable to open directory: " + directory.string());
+        }
+        rewind();
+    }
+
+    bool next(std::string& filename) override
+    {
+        while (iter != Iterator())
+        {
+            const auto path = iter->path();
+            const bool selected = pattern.empty() ? isImage(path) : match(pattern.c_str(), path.filename().string().c_str());
+            boost::system::error_code status;
+            const bool found = selected && bfs::is_regular_file(iter->status(status));
+            advance();
+            if (found)
+            {
+                filename = path.string();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Step to the next entry, logging and skipping unreadable ones:
+    void advance()
+    {
+        boost::system::error_code ec;
+        iter.increment(ec);
+        while (ec)
+        {
+            const auto entry = (iter != Iterator()) ? iter->path() : directory;
+            if (logger)
+            {
+                logger->warn("Skipping unreadable entry {}: {}", entry.string(), ec.message());
+            }
+            if (iter == Iterator())
+            {
+                break;
+            }
+
+            skip(iter);
+            ec.clear();
+            if (iter != Iterator())
+            {
+                iter.increment(ec);
+            }
+        }
+    }
+
+    void rewind() override
+    {
+        iter = Iterator(directory);
+    }
+
+    bfs::path directory;
+    std::string pattern;
+    std::shared_ptr<spdlog::logger> logger;
+    Iterator iter;
+};
+
+static std::unique_ptr<Cursor> createCursor(const std::string& filename, const std::shared_ptr<spdlog::logger>& logger)
+{
+    if (filename.find(".txt") != std::string::npos)
+    {
+        return detail::make_unique<FileCursor>(filename);
+    }
+    else if (hasWildcards(filename))
+    {
+        const bfs::path path(filename);
+        const auto parent = path.has_parent_path() ? path.parent_path() : bfs::path(".");
+        return detail::make_unique<DirectoryCursor<bfs::directory_iterator>>(parent, path.filename().string(), logger);
+    }
+    else if (bfs::is_directory(filename))
+    {
+        return detail::make_unique<DirectoryCursor<bfs::recursive_directory_iterator>>(filename, "", logger);
+    }
+
+    return detail::make_unique<VectorCursor>(std::vector<std::string>{ filename });
+}
+
+// }
+
+bool VideoCaptureList::isList(const std::string& filename)
+{
+    return (filename.find(".txt") != std::string::npos) || hasWildcards(filename) || bfs::is_directory(filename);
 }
 
 struct VideoCaptureList::Impl
 {
-    Impl(const std::string& filename)
+    Impl(const std::string& filename, const std::shared_ptr<spdlog::logger>& logger)
+        : cursor(createCursor(filename, logger))
+        , logger(logger)
     {
-        expand(filename, filenames);
         init();
     }
 
     Impl(const std::vector<std::string>& filenames)
-        : filenames(filenames)
+        : cursor(detail::make_unique<VectorCursor>(filenames))
+        , count(filenames.size())
     {
         init();
     }
 
-    void next()
+    void init()
     {
-        image = (++iter == filenames.end()) ? cv::imread(*iter) : cv::Mat();
+        // Decode the first image up front to report the frame dimensions,
+        // it is kept for the first retrieve() to avoid decoding it twice:
+        if (cursor->next(filename))
+        {
+            opened = true;
+            first = cv::imread(filename);
+            size = first.size();
+        }
+        cursor->rewind();
     }
 
-    void init()
+    bool grab()
+    {
+        if (cursor && cursor->next(filename))
+        {
+            next++;
+            return true;
+        }
+
+        count = next; // the end of the list is known now
+        return false;
+    }
+
+    // Move the cursor to frame index (without decoding):
+    void seek(std::size_t index)
     {
-        iter = filenames.begin();
-        image = cv::imread(*iter);
+        if (index < next)
+        {
+            cursor->rewind();
+            next = 0;
+        }
+        while ((next < index) && grab())
+        {
+        }
     }
 
-    cv::Mat image;
-    std::vector<std::string> filenames;
-    std::vector<std::string>::iterator iter;
+    cv::Mat retrieve()
+    {
+        if (next == 1 && !first.empty())
+        {
+            cv::Mat image = first;
+            first.release(); // only needed once
+            return image;
+        }
+        return cv::imread(filename, flags);
+    }
+
+    std::unique_ptr<Cursor> cursor;
+    std::shared_ptr<spdlog::logger> logger;
+    std::string filename; // last grabbed frame
+    bool opened = false;
+    cv::Mat first;
+    cv::Size size;
+    int flags = cv::IMREAD_COLOR;
+    std::size_t count = 0; // 0 == unknown
+    std::size_t next = 0;  // next frame to grab
 };
 
-VideoCaptureList::VideoCaptureList(const std::string& filename)
+VideoCaptureList::VideoCaptureList(const std::string& filename, const std::shared_ptr<spdlog::logger>& logger)
 {
-    m_impl = detail::make_unique<Impl>(filename);
+    m_impl = detail::make_unique<Impl>(filename, logger);
 }
 
 VideoCaptureList::VideoCaptureList(const std::vector<std::string>& filenames)
@@ -91,47 +345,97 @@ VideoCaptureList::~VideoCaptureList() = default;
 
 bool VideoCaptureList::grab()
 {
-    return false;
+    return m_impl->grab();
+}
+
+bool VideoCaptureList::retrieve(cv::OutputArray image, int flag)
+{
+    if (m_impl->next == 0)
+    {
+        return false; // nothing grabbed yet
+    }
+
+    image.assign(m_impl->retrieve());
+    return !image.empty();
 }
 
 bool VideoCaptureList::isOpened() const
 {
-    return m_impl->filenames.size() > 0;
+    return m_impl->cursor && m_impl->opened;
 }
 
 void VideoCaptureList::release()
 {
-    m_impl->filenames.clear();
-    m_impl->image.release();
+    m_impl->cursor.reset();
+    m_impl->first.release();
 }
 
 bool VideoCaptureList::open(const cv::String& filename)
 {
-    m_impl = detail::make_unique<Impl>(filename);
-    return !m_impl->image.empty();
+    m_impl = detail::make_unique<Impl>(filename, m_impl ? m_impl->logger : nullptr);
+    return m_impl->size.area() > 0;
 }
 
 bool VideoCaptureList::read(cv::OutputArray image)
 {
-    if (m_impl->iter != m_impl->filenames.end())
+    if (grab())
     {
-        image.assign(m_impl->image);
-        m_impl->next();
-        return true;
+        return retrieve(image);
     }
+    image.release();
     return false;
 }
 
+bool VideoCaptureList::set(int propId, double value)
+{
+    switch (propId)
+    {
+        case CV_CAP_PROP_POS_FRAMES: // seek (no decoding)
+            if (!m_impl->cursor)
+            {
+                return false;
+            }
+            m_impl->seek(static_cast<std::size_t>(std::max(value, 0.0)));
+            return true;
+        default:
+            return false;
+    }
+}
+
+void VideoCaptureList::setReduction(int factor)
+{
+    switch (factor)
+    {
+        case 2:
+            m_impl->flags = cv::IMREAD_REDUCED_COLOR_2;
+            break;
+        case 4:
+            m_impl->flags = cv::IMREAD_REDUCED_COLOR_4;
+            break;
+        case 8:
+            m_impl->flags = cv::IMREAD_REDUCED_COLOR_8;
+            break;
+        default:
+            m_impl->flags = cv::IMREAD_COLOR;
+            break;
+    }
+
+    // The cached first frame was decoded at full size:
+    m_impl->first.release();
+}
+
 double VideoCaptureList::get(int propId) const
 {
     switch (propId)
     {
         case CV_CAP_PROP_FRAME_WIDTH:
-            return static_cast<double>(m_impl->image.cols);
+            return static_cast<double>(m_impl->size.width);
         case CV_CAP_PROP_FRAME_HEIGHT:
-            return static_cast<double>(m_impl->image.rows);
+            return static_cast<double>(m_impl->size.height);
         case CV_CAP_PROP_FRAME_COUNT:
-            return static_cast<double>(m_impl->filenames.size());
+            return static_cast<double>(m_impl->count);
+        case CV_CAP_PROP_POS_FRAMES:
+            return static_cast<double>(m_impl->next);
         default:
             return 0.0;
     }
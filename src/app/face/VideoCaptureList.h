@@ -1,22 +1,41 @@
 #include <opencv2/highgui.hpp>
+#include <spdlog/spdlog.h> // for portable logging
 #include <memory>
 
 #ifndef __VideoCaptureList_h__
 #define __VideoCaptureList_h__
 
+// Image list input: grab() advances to the next file without decoding it and
+// retrieve() decodes the grabbed file, so skipped frames are never read.
+//
+// The filenames are streamed from a cursor, so memory doesn't grow with the
+// number of images:
+// - list.txt: one path per line (read incrementally)
+// - directory: all images below the directory (walked lazily, in filesystem order)
+// - dir/*.png: files in the directory matching the wildcards (* and ?, not in URLs)
+// Unreadable directory entries are skipped (and logged, given a logger).
+// The frame count of a streamed list is unknown (0) until the end is reached.
 class VideoCaptureList : public cv::VideoCapture
 {
 public:
-    VideoCaptureList(const std::string& filename);
+    // Return true for a list file, a directory or a wildcard pattern:
+    static bool isList(const std::string& filename);
+
+    VideoCaptureList(const std::string& filename, const std::shared_ptr<spdlog::logger>& logger = nullptr);
     VideoCaptureList(const std::vector<std::string>& filenames);
     virtual ~VideoCaptureList();
     virtual bool grab();
+    virtual bool retrieve(cv::OutputArray image, int flag = 0);
     virtual bool isOpened() const;
     virtual void release();
     virtual bool open(const cv::String& filename);
     virtual bool read(cv::OutputArray image);
+    virtual bool set(int propId, double value);
     double get(int propId) const;
 
+    // Decode at 1/factor size where the codec supports it (1, 2, 4 or 8):
+    void setReduction(int factor);
+
     struct Impl;
     std::unique_ptr<Impl> m_impl;
 };
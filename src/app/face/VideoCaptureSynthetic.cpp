@@ -0,0 +1,401 @@
+/*!
+  @file   VideoCaptureSynthetic.cpp
+  @author David Hirvonen
+  @brief  Synthetic in memory video source for load testing (no decode cost).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "VideoCaptureSynthetic.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+static const std::string kPrefix = "synthetic:";
+
+namespace detail
+{
+    template <typename T, typename... Args>
+    std::unique_ptr<T> make_unique(Args&&... args)
+    {
+        return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
+    }
+}
+
+struct Settings
+{
+    cv::Size size;
+    double fps = 0.0;
+    std::string loop;   // background image
+    std::string sprite; // sprite image (optional alpha channel)
+    int faces = 0;
+    std::size_t frames = 0; // 0 == unlimited
+};
+
+static Settings parse(const std::string& spec)
+{
+    if (!VideoCaptureSynthetic::isSynthetic(spec))
+    {
+        throw std::runtime_error("VideoCaptureSynthetic: expected " + kPrefix + "<width>x<height>@<fps>[:key=value]: " + spec);
+    }
+
+    // Fields are separated by ':', a field without '=' continues the previous
+    // value so that paths with a drive letter (c:/...) survive:
+    std::vector<std::string> fields;
+    std::stringstream ss(spec.substr(kPrefix.size()));
+    for (std::string field; std::getline(ss, field, ':');)
+    {
+        if (!fields.empty() && (field.find('=') == std::string::npos))
+        {
+            fields.back() += ":" + field;
+        }
+        else
+        {
+            fields.push_back(field);
+        }
+    }
+
+    Settings settings;
+
+    char x = 0, at = 0;
+    std::stringstream geometry(fields.empty() ? std::string() : fields.front());
+    if (!(geometry >> settings.size.width >> x >> settings.size.height >> at >> settings.fps) || (x != 'x') || (at != '@'))
+    {
+        throw std::runtime_error("VideoCaptureSynthetic: expected <width>x<height>@<fps>: " + spec);
+    }
+
+    if ((settings.size.width <= 0) || (settings.size.height <= 0) || (settings.size.width % 2) || (settings.size.height % 2) || !(settings.fps > 0.0))
+    {
+        throw std::runtime_error("VideoCaptureSynthetic: invalid geometry (even dimensions and fps > 0): " + spec);
+    }
+
+    for (std::size_t i = 1; i < fields.size(); i++)
+    {
+        const auto pos = fields[i].find('=');
+        const std::string key = fields[i].substr(0, pos), value = fields[i].substr(pos + 1);
+        if (key == "loop")
+        {
+            settings.loop = value;
+        }
+        else if (key == "sprite")
+        {
+            settings.sprite = value;
+            settings.faces = std::max(settings.faces, 1);
+        }
+        else if (key == "faces")
+        {
+            settings.faces = std::max(std::atoi(value.c_str()), 0);
+        }
+        else if (key == "frames")
+        {
+            settings.frames = static_cast<std::size_t>(std::max(std::strtoll(value.c_str(), nullptr, 10), 0LL));
+        }
+        else
+        {
+            throw std::runtime_error("VideoCaptureSynthetic: unknown key " + key + ": " + spec);
+        }
+    }
+
+    return settings;
+}
+
+// Bounce between [0, range] with constant speed (a function of the frame index so seeks are exact):
+static int bounce(float start, float velocity, std::size_t index, int range)
+{
+    if (range <= 0)
+    {
+        return 0;
+    }
+    const float period = 2.f * range;
+    float t = std::fmod(start + velocity * static_cast<float>(index), period);
+    t = (t < 0.f) ? (t + period) : t;
+    return static_cast<int>((t <= range) ? t : (period - t));
+}
+
+struct VideoCaptureSynthetic::Impl
+{
+    struct Sprite
+    {
+        cv::Point2f start;
+        cv::Point2f velocity; // pixels per frame
+        cv::Rect drawn;       // last rendered position
+    };
+
+    Impl(const std::string& spec)
+        : settings(parse(spec))
+    {
+        // The background is resized once, frames are generated from memory:
+        if (!settings.loop.empty())
+        {
+            cv::Mat image = cv::imread(settings.loop, cv::IMREAD_COLOR);
+            if (image.empty())
+            {
+                throw std::runtime_error("VideoCaptureSynthetic: unable to read " + settings.loop);
+            }
+            cv::resize(image, masters[0], settings.size, 0, 0, cv::INTER_AREA);
+        }
+        else
+        {
+            // Smooth content (a flat image is unrealistically cheap for the detector):
+            masters[0].create(settings.size, CV_8UC3);
+            cv::randu(masters[0], cv::Scalar::all(0), cv::Scalar::all(255));
+            cv::blur(masters[0], masters[0], { 15, 15 });
+        }
+
+        if (settings.faces > 0)
+        {
+            createSprite();
+
+            cv::RNG rng(settings.faces);
+            const float speed = settings.size.height / 120.f;
+            for (int i = 0; i < settings.faces; i++)
+            {
+                const cv::Point2f start(rng.uniform(0.f, 1.f) * settings.size.width, rng.uniform(0.f, 1.f) * settings.size.height);
+                const cv::Point2f velocity(rng.uniform(-speed, speed), rng.uniform(-speed, speed));
+                sprites.push_back({ start, velocity, {} });
+            }
+        }
+
+        init();
+    }
+
+    // Sprites are sized relative to the frame (a face at a typical capture distance):
+    void createSprite()
+    {
+        const int height = std::max(settings.size.height / 4, 2);
+
+        if (!settings.sprite.empty())
+        {
+            cv::Mat image = cv::imread(settings.sprite, cv::IMREAD_UNCHANGED);
+            if (image.empty())
+            {
+                throw std::runtime_error("VideoCaptureSynthetic: unable to read " + settings.sprite);
+            }
+
+            const cv::Size size(std::max(image.cols * height / image.rows, 1), height);
+            cv::resize(image, image, size, 0, 0, cv::INTER_AREA);
+            switch (image.channels())
+            {
+                case 4:
+                    cv::extractChannel(image, mask, 3);
+                    cv::cvtColor(image, masters[1], cv::COLOR_BGRA2BGR);
+                    break;
+                case 1:
+                    cv::cvtColor(image, masters[1], cv::COLOR_GRAY2BGR);
+                    break;
+                default:
+                    masters[1] = image;
+                    break;
+            }
+        }
+        else
+        {
+            // A simple procedural face (skin, eyes and mouth):
+            const cv::Size size(height * 3 / 4, height);
+            const cv::Point center(size.width / 2, size.height / 2);
+            masters[1] = cv::Mat(size, CV_8UC3, cv::Scalar(96, 128, 192));
+            cv::circle(masters[1], center + cv::Point(-size.width / 5, -size.height / 8), size.width / 10, cv::Scalar::all(32), -1);
+            cv::circle(masters[1], center + cv::Point(+size.width / 5, -size.height / 8), size.width / 10, cv::Scalar::all(32), -1);
+            cv::ellipse(masters[1], center + cv::Point(0, size.height / 4), { size.width / 5, size.height / 16 }, 0.0, 0.0, 180.0, cv::Scalar(64, 64, 160), -1);
+        }
+
+        if (mask.empty())
+        {
+            mask = cv::Mat1b::zeros(masters[1].size());
+            cv::ellipse(mask, { mask.cols / 2, mask.rows / 2 }, { mask.cols / 2, mask.rows / 2 }, 0.0, 0.0, 360.0, cv::Scalar::all(255), -1);
+        }
+    }
+
+    // (Re)build the working images for the current output format:
+    void init()
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            if (convertRGB || masters[i].empty())
+            {
+                images[i] = masters[i];
+            }
+            else
+            {
+                cv::cvtColor(masters[i], images[i], cv::COLOR_BGR2GRAY);
+            }
+        }
+
+        images[0].copyTo(frame);
+        for (auto& sprite : sprites)
+        {
+            sprite.drawn = {};
+        }
+    }
+
+    bool grab()
+    {
+        if ((settings.frames > 0) && (next >= settings.frames))
+        {
+            return false;
+        }
+
+        current = next++;
+        grabbed = true;
+
+        if (!sprites.empty())
+        {
+            // Restore the last sprite rectangles before drawing any sprite (they can overlap):
+            for (auto& sprite : sprites)
+            {
+                if (sprite.drawn.area() > 0)
+                {
+                    images[0](sprite.drawn).copyTo(frame(sprite.drawn));
+                }
+            }
+
+            const cv::Size range = settings.size - images[1].size();
+            for (auto& sprite : sprites)
+            {
+                const cv::Point tl(bounce(sprite.start.x, sprite.velocity.x, current, range.width), bounce(sprite.start.y, sprite.velocity.y, current, range.height));
+                sprite.drawn = cv::Rect(tl, images[1].size()) & cv::Rect(cv::Point(), settings.size);
+
+                const cv::Rect roi(cv::Point(), sprite.drawn.size());
+                images[1](roi).copyTo(frame(sprite.drawn), mask(roi));
+            }
+        }
+
+        return true;
+    }
+
+    bool retrieve(cv::OutputArray image)
+    {
+        if (!grabbed)
+        {
+            return false;
+        }
+        image.assign(frame); // shared (valid until the next grab())
+        return true;
+    }
+
+    Settings settings;
+    bool convertRGB = true;
+
+    cv::Mat masters[2]; // { background, sprite } (BGR)
+    cv::Mat images[2];  // { background, sprite } in the output format
+    cv::Mat1b mask;     // sprite mask
+    cv::Mat frame;      // generator buffer
+
+    std::vector<Sprite> sprites;
+    std::size_t current = 0; // last grabbed frame
+    std::size_t next = 0;    // next frame to grab
+    bool grabbed = false;
+};
+
+VideoCaptureSynthetic::VideoCaptureSynthetic(const std::string& spec)
+{
+    m_impl = detail::make_unique<Impl>(spec);
+}
+
+VideoCaptureSynthetic::~VideoCaptureSynthetic() = default;
+
+bool VideoCaptureSynthetic::isSynthetic(const std::string& spec)
+{
+    return spec.compare(0, kPrefix.size(), kPrefix) == 0;
+}
+
+bool VideoCaptureSynthetic::grab()
+{
+    return m_impl && m_impl->grab();
+}
+
+bool VideoCaptureSynthetic::retrieve(cv::OutputArray image, int flag)
+{
+    return m_impl && m_impl->retrieve(image);
+}
+
+bool VideoCaptureSynthetic::isOpened() const
+{
+    return static_cast<bool>(m_impl);
+}
+
+void VideoCaptureSynthetic::release()
+{
+    m_impl.reset();
+}
+
+bool VideoCaptureSynthetic::open(const cv::String& spec)
+{
+    m_impl = detail::make_unique<Impl>(spec);
+    return isOpened();
+}
+
+bool VideoCaptureSynthetic::read(cv::OutputArray image)
+{
+    if (grab())
+    {
+        return retrieve(image);
+    }
+    image.release();
+    return false;
+}
+
+bool VideoCaptureSynthetic::set(int propId, double value)
+{
+    if (!m_impl)
+    {
+        return false;
+    }
+
+    switch (propId)
+    {
+        case CV_CAP_PROP_CONVERT_RGB:
+            if (m_impl->convertRGB != (value != 0.0))
+            {
+                m_impl->convertRGB = (value != 0.0);
+                m_impl->init();
+            }
+            return true;
+        case CV_CAP_PROP_POS_FRAMES:
+            if ((value >= 0.0) && ((m_impl->settings.frames == 0) || (static_cast<std::size_t>(value) <= m_impl->settings.frames)))
+            {
+                m_impl->next = static_cast<std::size_t>(value);
+                m_impl->grabbed = false;
+                return true;
+            }
+            return false;
+        default:
+            return false; // the geometry and rate are fixed by the spec
+    }
+}
+
+double VideoCaptureSynthetic::get(int propId) const
+{
+    if (!m_impl)
+    {
+        return 0.0;
+    }
+
+    switch (propId)
+    {
+        case CV_CAP_PROP_FRAME_WIDTH:
+            return m_impl->settings.size.width;
+        case CV_CAP_PROP_FRAME_HEIGHT:
+            return m_impl->settings.size.height;
+        case CV_CAP_PROP_FPS:
+            return m_impl->settings.fps;
+        case CV_CAP_PROP_CONVERT_RGB:
+            return m_impl->convertRGB ? 1.0 : 0.0;
+        case CV_CAP_PROP_FRAME_COUNT:
+            return static_cast<double>(m_impl->settings.frames);
+        case CV_CAP_PROP_POS_FRAMES:
+            return static_cast<double>(m_impl->next);
+        case CV_CAP_PROP_POS_MSEC:
+            return static_cast<double>(m_impl->current) * 1000.0 / m_impl->settings.fps;
+        default:
+            return 0.0;
+    }
+}
@@ -0,0 +1,55 @@
+/*!
+  @file   VideoCaptureSynthetic.h
+  @author David Hirvonen
+  @brief  Synthetic in memory video source for load testing (no decode cost).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  Frames are generated from a background image (resized once) with optional
+  moving sprites composited on top.  Only the sprite rectangles are redrawn
+  for each frame, so generation cost doesn't depend on the resolution:
+
+  synthetic:<width>x<height>@<fps>[:loop=<image>][:sprite=<image>][:faces=<n>][:frames=<n>]
+
+  synthetic:1920x1080@240:loop=img.png
+  synthetic:1280x720@120:loop=img.png:sprite=face.png:faces=4:frames=10000
+
+  The frame rate is reported through CV_CAP_PROP_FPS and the timestamps
+  (CV_CAP_PROP_POS_MSEC), frames are generated as fast as they are read.
+  Without a frame count the source never ends.  With CV_CAP_PROP_CONVERT_RGB
+  == 0 frames are generated as single channel luminance images.  Retrieved
+  frames share the generator buffer (valid until the next grab()).
+
+*/
+
+#ifndef __VideoCaptureSynthetic_h__
+#define __VideoCaptureSynthetic_h__
+
+#include <opencv2/highgui.hpp>
+
+#include <memory>
+#include <string>
+
+class VideoCaptureSynthetic : public cv::VideoCapture
+{
+public:
+    VideoCaptureSynthetic(const std::string& spec);
+    virtual ~VideoCaptureSynthetic();
+    virtual bool grab();
+    virtual bool retrieve(cv::OutputArray image, int flag = 0);
+    virtual bool isOpened() const;
+    virtual void release();
+    virtual bool open(const cv::String& spec);
+    virtual bool read(cv::OutputArray image);
+    virtual bool set(int propId, double value);
+    double get(int propId) const;
+
+    // Recognize synthetic input by prefix ("synthetic:"):
+    static bool isSynthetic(const std::string& spec);
+
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+#endif // __VideoCaptureSynthetic_h__
@@ -0,0 +1,266 @@
+/*!
+  @file   VideoCaptureYUV.cpp
+  @author David Hirvonen
+  @brief  Raw NV12/I420 input (memory mapped files or sequential streams).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+*/
+
+#include "VideoCaptureYUV.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// clang-format off
+#if defined(__unix__) || defined(__APPLE__)
+#  define DRISHTI_SDK_TEST_HAVE_MMAP 1
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+// clang-format on
+
+namespace detail
+{
+    template <typename T, typename... Args>
+    std::unique_ptr<T> make_unique(Args&&... args)
+    {
+        return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
+    }
+}
+
+static std::string getExtension(const std::string& filename)
+{
+    const auto pos = filename.find_last_of('.');
+    std::string extension = (pos == std::string::npos) ? std::string() : filename.substr(pos + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension;
+}
+
+struct VideoCaptureYUV::Impl
+{
+    Impl(const std::string& filename)
+        : format((getExtension(filename) == "nv12") ? kNV12 : kI420)
+    {
+#if defined(DRISHTI_SDK_TEST_HAVE_MMAP)
+        // Regular files are mapped, pipes and devices are read sequentially:
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            struct stat info;
+            if ((::fstat(fd, &info) == 0) && S_ISREG(info.st_mode) && (info.st_size > 0))
+            {
+                void* ptr = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (ptr != MAP_FAILED)
+                {
+                    ::madvise(ptr, info.st_size, MADV_SEQUENTIAL);
+                    data = static_cast<std::uint8_t*>(ptr);
+                    length = static_cast<std::size_t>(info.st_size);
+                }
+            }
+            ::close(fd); // the mapping holds its own reference
+        }
+#endif
+
+        if (!isMapped())
+        {
+            stream.open(filename, std::ios::binary);
+        }
+    }
+
+    ~Impl()
+    {
+        close();
+    }
+
+    void close()
+    {
+#if defined(DRISHTI_SDK_TEST_HAVE_MMAP)
+        if (data)
+        {
+            ::munmap(data, length);
+        }
+#endif
+        data = nullptr;
+        length = 0;
+        stream.close();
+    }
+
+    bool isOpened() const { return isMapped() || stream.is_open(); }
+    bool isMapped() const { return data != nullptr; }
+
+    // 12 bits per pixel for both layouts:
+    std::size_t getFrameBytes() const { return (size.area() * 3) / 2; }
+
+    std::size_t getFrameCount() const
+    {
+        const auto bytes = getFrameBytes();
+        return (isMapped() && bytes) ? (length / bytes) : 0;
+    }
+
+    bool grab()
+    {
+        const auto bytes = getFrameBytes();
+        if (!isOpened() || (bytes == 0) || (size.width % 2) || (size.height % 2))
+        {
+            return false;
+        }
+
+        if (isMapped())
+        {
+            if (next >= getFrameCount())
+            {
+                return false;
+            }
+            frame = data + (next++ * bytes);
+            return true;
+        }
+
+        // Streams: the frame must be consumed even if it is never retrieved.
+        buffer.resize(bytes);
+        if (!stream.read(reinterpret_cast<char*>(buffer.data()), bytes))
+        {
+            return false;
+        }
+        frame = buffer.data();
+        next++;
+        return true;
+    }
+
+    bool retrieve(cv::OutputArray image)
+    {
+        if (!frame)
+        {
+            return false;
+        }
+
+        // The Y plane is a zero copy header (valid until the next grab()):
+        cv::Mat yuv(size.height * 3 / 2, size.width, CV_8UC1, const_cast<std::uint8_t*>(frame));
+        if (!convertRGB)
+        {
+            image.assign(yuv.rowRange(0, size.height));
+        }
+        else
+        {
+            cv::cvtColor(yuv, image, (format == kNV12) ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2BGR_I420);
+        }
+        return true;
+    }
+
+    Format format;
+    cv::Size size;
+    bool convertRGB = true;
+
+    std::uint8_t* data = nullptr; // mapped file
+    std::size_t length = 0;
+    std::ifstream stream;             // sequential input (pipes, devices)
+    std::vector<std::uint8_t> buffer; // reused for each streamed frame
+
+    const std::uint8_t* frame = nullptr; // last grabbed frame
+    std::size_t next = 0;                // next frame to grab
+};
+
+VideoCaptureYUV::VideoCaptureYUV(const std::string& filename)
+{
+    m_impl = detail::make_unique<Impl>(filename);
+}
+
+VideoCaptureYUV::~VideoCaptureYUV() = default;
+
+bool VideoCaptureYUV::isYUV(const std::string& filename)
+{
+    const auto extension = getExtension(filename);
+    return (extension == "nv12") || (extension == "i420") || (extension == "yuv");
+}
+
+bool VideoCaptureYUV::grab()
+{
+    return m_impl->grab();
+}
+
+bool VideoCaptureYUV::retrieve(cv::OutputArray image, int flag)
+{
+    return m_impl->retrieve(image);
+}
+
+bool VideoCaptureYUV::isOpened() const
+{
+    return m_impl->isOpened();
+}
+
+void VideoCaptureYUV::release()
+{
+    m_impl->close();
+    m_impl->frame = nullptr;
+}
+
+bool VideoCaptureYUV::open(const cv::String& filename)
+{
+    const auto size = m_impl->size;
+    m_impl = detail::make_unique<Impl>(filename);
+    m_impl->size = size;
+    return m_impl->isOpened();
+}
+
+bool VideoCaptureYUV::read(cv::OutputArray image)
+{
+    if (grab())
+    {
+        return retrieve(image);
+    }
+    image.release();
+    return false;
+}
+
+bool VideoCaptureYUV::set(int propId, double value)
+{
+    switch (propId)
+    {
+        case CV_CAP_PROP_FRAME_WIDTH:
+            m_impl->size.width = static_cast<int>(value);
+            return true;
+        case CV_CAP_PROP_FRAME_HEIGHT:
+            m_impl->size.height = static_cast<int>(value);
+            return true;
+        case CV_CAP_PROP_CONVERT_RGB:
+            m_impl->convertRGB = (value != 0.0);
+            return true;
+        case CV_CAP_PROP_POS_FRAMES:
+            if (m_impl->isMapped() && (value >= 0.0) && (static_cast<std::size_t>(value) <= m_impl->getFrameCount()))
+            {
+                m_impl->next = static_cast<std::size_t>(value);
+                m_impl->frame = nullptr;
+                return true;
+            }
+            return false; // streams can't seek
+        default:
+            return false;
+    }
+}
+
+double VideoCaptureYUV::get(int propId) const
+{
+    switch (propId)
+    {
+        case CV_CAP_PROP_FRAME_WIDTH:
+            return m_impl->size.width;
+        case CV_CAP_PROP_FRAME_HEIGHT:
+            return m_impl->size.height;
+        case CV_CAP_PROP_CONVERT_RGB:
+            return m_impl->convertRGB ? 1.0 : 0.0;
+        case CV_CAP_PROP_FRAME_COUNT:
+            return static_cast<double>(m_impl->getFrameCount());
+        case CV_CAP_PROP_POS_FRAMES:
+            return static_cast<double>(m_impl->next);
+        default:
+            return 0.0;
+    }
+}
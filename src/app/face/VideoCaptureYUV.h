@@ -0,0 +1,51 @@
+/*!
+  @file   VideoCaptureYUV.h
+  @author David Hirvonen
+  @brief  Raw NV12/I420 input (memory mapped files or sequential streams).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  Raw frames have no header, so the dimensions must be provided with
+  set(CV_CAP_PROP_FRAME_WIDTH/HEIGHT) before the first grab().  With
+  CV_CAP_PROP_CONVERT_RGB == 0, retrieve() returns the Y plane without
+  a copy (or color conversion), otherwise frames are converted to BGR.
+
+*/
+
+#ifndef __VideoCaptureYUV_h__
+#define __VideoCaptureYUV_h__
+
+#include <opencv2/highgui.hpp>
+
+#include <memory>
+#include <string>
+
+class VideoCaptureYUV : public cv::VideoCapture
+{
+public:
+    enum Format
+    {
+        kNV12, // Y plane + interleaved UV plane
+        kI420  // Y plane + U plane + V plane
+    };
+
+    VideoCaptureYUV(const std::string& filename);
+    virtual ~VideoCaptureYUV();
+    virtual bool grab();
+    virtual bool retrieve(cv::OutputArray image, int flag = 0);
+    virtual bool isOpened() const;
+    virtual void release();
+    virtual bool open(const cv::String& filename);
+    virtual bool read(cv::OutputArray image);
+    virtual bool set(int propId, double value);
+    double get(int propId) const;
+
+    // Recognize raw input by file extension (.nv12, .i420 or .yuv):
+    static bool isYUV(const std::string& filename);
+
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+#endif // __VideoCaptureYUV_h__
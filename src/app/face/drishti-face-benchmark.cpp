@@ -0,0 +1,244 @@
+/*!
+  @file   drishti-face-benchmark.cpp
+  @author David Hirvonen
+  @brief  Microbenchmarks for the application side runtime components.
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  These are the pieces that run on every frame outside of the SDK.  Results
+  can be compared across commits with the google benchmark JSON output:
+
+  drishti-face-benchmark \
+    --benchmark_out=before.json \
+    --benchmark_out_format=json
+
+  compare.py benchmarks before.json after.json
+
+  The FaceTrackerFactoryJson benchmark requires a model descriptor:
+
+  DRISHTI_FACE_MODELS=${SOME_PATH_VAR}/drishti_assets.json drishti-face-benchmark
+
+*/
+
+// Need std:: extensions for android targets
+#if !defined(DRISHTI_SDK_TEST_HAVE_TO_STRING)
+#  include "stdlib_string.h"
+#endif
+
+#include "AsyncWorker.h"
+#include "FaceTrackerFactoryJson.h"
+#include "FaceTrackerTest.h"
+#include "VideoCaptureList.h"
+#include "VideoCaptureSynthetic.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/null_sink.h>
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::shared_ptr<spdlog::logger> createLogger(const char* name)
+{
+    auto logger = spdlog::get(name);
+    if (!logger)
+    {
+        logger = std::make_shared<spdlog::logger>(name, std::make_shared<spdlog::sinks::null_sink_mt>());
+        spdlog::register_logger(logger);
+    }
+    return logger;
+}
+
+// Measure the deep copy + queue hand off only (no file output):
+class FaceTrackBench : public FaceTrackTest
+{
+public:
+    FaceTrackBench(std::shared_ptr<spdlog::logger>& logger)
+        : FaceTrackTest(logger, std::string())
+    {
+    }
+
+    void process(StackType& stack) override {}
+};
+
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+// AsyncWorker::post() round trip (post -> run -> notify):
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+static void BM_AsyncWorkerPost(benchmark::State& state)
+{
+    AsyncWorker<std::function<void()>> worker;
+    worker.start();
+
+    for (auto _ : state)
+    {
+        std::promise<void> done;
+        worker.post([&done] { done.set_value(); });
+        done.get_future().wait();
+    }
+
+    worker.stop();
+}
+BENCHMARK(BM_AsyncWorkerPost)->UseRealTime();
+
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+// VideoCaptureList::read() for different codecs (640x480):
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+static const char* kExtensions[] = { ".png", ".jpg", ".bmp" };
+
+static void BM_VideoCaptureListRead(benchmark::State& state)
+{
+    const std::string extension = kExtensions[state.range(0)];
+    const int count = 8;
+
+    // Smooth synthetic content, so compression ratios aren't degenerate:
+    cv::Mat image(480, 640, CV_8UC3);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::blur(image, image, { 15, 15 });
+
+    std::vector<std::string> filenames;
+    for (int i = 0; i < count; i++)
+    {
+        std::stringstream ss;
+        ss << "drishti-face-benchmark_" << i << extension;
+        filenames.push_back(ss.str());
+        cv::imwrite(filenames.back(), image);
+    }
+
+    VideoCaptureList video(filenames);
+
+    cv::Mat frame;
+    for (auto _ : state)
+    {
+        if (!video.read(frame))
+        {
+            video.set(CV_CAP_PROP_POS_FRAMES, 0.0);
+            video.read(frame);
+        }
+        benchmark::DoNotOptimize(frame.data);
+    }
+
+    state.SetLabel(extension);
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+
+    for (const auto& filename : filenames)
+    {
+        std::remove(filename.c_str());
+    }
+}
+BENCHMARK(BM_VideoCaptureListRead)->DenseRange(0, 2);
+
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+// VideoCaptureSynthetic::read() with N sprites (1080p):
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+static void BM_VideoCaptureSyntheticRead(benchmark::State& state)
+{
+    VideoCaptureSynthetic video("synthetic:1920x1080@240:faces=" + std::to_string(state.range(0)));
+
+    cv::Mat frame;
+    for (auto _ : state)
+    {
+        video.read(frame);
+        benchmark::DoNotOptimize(frame.data);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VideoCaptureSyntheticRead)->Arg(0)->Arg(1)->Arg(4)->Arg(16);
+
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+// FaceTrackTest::callback() deep copy for N results:
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+static void BM_Callback(benchmark::State& state)
+{
+    const auto count = static_cast<std::size_t>(state.range(0));
+
+    // Typical capture sizes: full frame (VGA) + eye crop:
+    cv::Mat4b frame(480, 640, cv::Vec4b(0, 0, 0, 255));
+    cv::Mat4b eyes(128, 256, cv::Vec4b(0, 0, 0, 255));
+
+    drishti::sdk::Array<drishti_face_tracker_result_t, 64> results;
+    results.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        results[i].image.image = drishti::sdk::cvToDrishti<cv::Vec4b, drishti::sdk::Vec4b>(frame);
+        results[i].eyes.image = drishti::sdk::cvToDrishti<cv::Vec4b, drishti::sdk::Vec4b>(eyes);
+    }
+
+    auto logger = createLogger("drishti-face-benchmark");
+    FaceTrackBench callbacks(logger);
+
+    for (auto _ : state)
+    {
+        callbacks.callback(results);
+    }
+
+    state.SetBytesProcessed(state.iterations() * count * (frame.total() + eyes.total()) * 4);
+}
+BENCHMARK(BM_Callback)->RangeMultiplier(2)->Range(1, 64)->UseRealTime();
+
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+// FaceTrackTest::shouldCapture() for N faces (none in range):
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+static void BM_ShouldCapture(benchmark::State& state)
+{
+    const auto count = static_cast<std::size_t>(state.range(0));
+
+    drishti_face_tracker_result_t faces;
+    faces.faceModels.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto& position = faces.faceModels[i].position;
+        position[0] = 1.f;
+        position[1] = 1.f;
+        position[2] = 2.f;
+    }
+
+    auto logger = createLogger("drishti-face-benchmark");
+    FaceTrackBench callbacks(logger);
+    callbacks.setCaptureSphere({ { 0.f, 0.f, 0.5f } }, 0.33f, 0.0);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(callbacks.shouldCapture(faces));
+    }
+}
+BENCHMARK(BM_ShouldCapture)->RangeMultiplier(2)->Range(1, 64);
+
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+// FaceTrackerFactoryJson construction (model file loading):
+// :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+static void BM_FaceTrackerFactoryJson(benchmark::State& state)
+{
+    const char* models = std::getenv("DRISHTI_FACE_MODELS");
+    if (!models)
+    {
+        state.SkipWithError("DRISHTI_FACE_MODELS is not set");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        FaceTrackerFactoryJson factory(models, "drishti-face-benchmark");
+        benchmark::DoNotOptimize(static_cast<bool>(factory));
+    }
+}
+BENCHMARK(BM_FaceTrackerFactoryJson)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
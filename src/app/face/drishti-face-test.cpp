@@ -27,6 +27,25 @@
 #include "FaceTrackerTest.h"
 #include "FaceTrackerFactoryJson.h"
 #include "VideoCaptureList.h"
+#include "VideoCaptureSynthetic.h"
+#include "VideoCaptureYUV.h"
+#include "PipelineStage.h"
+#include "PipelineStats.h"
+#include "FrameIngest.h"
+#include "FramePacer.h"
+#include "FrameTrace.h"
+#include "ControlServer.h"
+#include "AllocationTracker.h"
+#include "HardwareCounters.h"
+#include "EyeRefiner.h"
+#include "CaptureWriter.h"
+#include "MetricsServer.h"
+#include "FrameResult.h"
+#include "SegmentRunner.h"
+#include "PipelineComparison.h"
+#include "ThreadTopology.h"
+
+#include "PerfReport.h"
 
 #include <opencv2/core.hpp>    // for cv::Mat
 #include <opencv2/imgproc.hpp> // for cv::cvtColor()
@@ -36,10 +55,18 @@
 
 #include <cxxopts.hpp> // for CLI parsing
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <csignal>
 #include <fstream>
 #include <istream>
 #include <sstream>
 #include <iomanip>
+#include <map>
 
 // clang-format off
 #ifdef ANDROID
@@ -53,7 +80,8 @@ struct Params
 {
     int videoWidth = 0;
     int videoHeight = 0;
-    float focalLength = 0.f;
+    float focalLength = 0.f; // pixels (at videoWidth x videoHeight)
+    int ingestWidth = 0;     // tracker resolution (0 == source resolution)
     
     bool multiFace = false;
     float minDetectionDistance = 0.f;
@@ -78,17 +106,59 @@ static void to_json(const std::string &filename, const Params &params);
 #endif
 
 using FaceResources = drishti::sdk::FaceTracker::Resources;
-static std::shared_ptr<cv::VideoCapture> create(const std::string& filename);
+static std::shared_ptr<cv::VideoCapture> create(const std::string& filename, std::shared_ptr<spdlog::logger>& logger);
 static std::shared_ptr<spdlog::logger> createLogger(const char* name);
 static cv::Size getSize(const cv::VideoCapture& video);
+static std::shared_ptr<drishti::sdk::FaceTracker> createTracker(const Params& params, const cv::Size& size, const cv::Size& sourceSize, FaceResources& resources);
+static void addControlCommands(ControlServer& control, TaskQueue& tasks, std::function<void(const Params&)> rebuild, Params& params);
+static std::size_t advance(cv::VideoCapture& video, std::size_t position, std::size_t count, bool doSeek);
+
+// Request an on demand trace flush (i.e., kill -USR1 <pid>):
+static std::atomic<bool> gDoTraceFlush{ false };
+static void requestTraceFlush(int) { gDoTraceFlush = true; }
 
 int gauze_main(int argc, char** argv)
 {
     const auto argumentCount = argc;
 
     float captureZ = 0.f;
+    double captureInterval = 8.0;
+    double captureBudget = 0.0; // MB
+    std::string sBudgetPolicy = "skip";
+    std::string sEyeModel;
+    int eyeThreads = 2;
+    int eyeQueue = 8;
+    int eyeWidth = 0;
+    std::string sWriter = "auto";
+    CaptureWriter::Settings writerSettings;
+    int writerDepth = static_cast<int>(writerSettings.depth);
+    int writerThreads = static_cast<int>(writerSettings.threads);
+    int writerQueue = static_cast<int>(writerSettings.queue);
+    int dedupe = -1;
+    float eyeQuality = -1.f;
+    float roiPadding = -1.f;
+    std::string sRoiSize;
+    float maxVelocity = 0.f;
+    float maxAcceleration = 0.f;
+    int stillFrames = 3;
     bool doPreview = false;
-    std::string sInput, sOutput, sModels, sConfig;
+    int logRate = 1;
+    int metricsPort = 0;
+    int segmentCount = 1;
+    int segmentWarmup = 30;
+    int frameStart = 0;
+    int frameEnd = 0;
+    int frameStride = 1;
+    double samplePeriod = 0.0;
+    bool doSeek = false;
+    bool doLuminance = false;
+    bool doRealtime = false;
+    double realtimeFps = 0.0;
+    std::string sInput, sOutput, sModels, sConfig, sTrace, sControl, sResults, sCompare;
+    int traceCapacity = 1 << 16;
+    bool doHardwareCounters = false;
+    int allocLimit = -1; // max allocations per frame (tracker thread)
+    int allocWarmup = 30;
 
 #if defined(DRISHTI_SDK_TEST_HAVE_LOCALECONV)
     std::string sBoilerplate;
@@ -101,15 +171,17 @@ int gauze_main(int argc, char** argv)
     // clang-format off
     options.add_options()
         // input/output:
-        ("i,input", "Input image", cxxopts::value<std::string>(sInput))
+        ("i,input", "Input image, video, list (.txt), directory, glob (dir/*.png), raw YUV or synthetic:WxH@fps[:loop=img.png]", cxxopts::value<std::string>(sInput))
         ("o,output", "Output image", cxxopts::value<std::string>(sOutput))
         ("m,models", "Model factory configuration file (JSON)", cxxopts::value<std::string>(sModels))
         ("c,config", "Configuration file", cxxopts::value<std::string>(sConfig))
+        ("results", "Per-frame tracking results (JSON lines)", cxxopts::value<std::string>(sResults))
 #if defined(DRISHTI_SDK_TEST_HAVE_LOCALECONV)
         ("boilerplate", "Dump boilerplate json file (then quit)", cxxopts::value<std::string>(sBoilerplate))
 #endif
         // context parameters (configuratino):
         ("focal-length", "focal length", cxxopts::value<float>(params.focalLength))
+        ("ingest-width", "Resize frames to this width on ingest (intrinsics are rescaled)", cxxopts::value<int>(params.ingestWidth))
         ("multi-face", "Support multiple faces", cxxopts::value<bool>(params.multiFace))
         ("min", "Closest object distance", cxxopts::value<float>(params.minDetectionDistance))
         ("max", "Farthest object distance", cxxopts::value<float>(params.maxDetectionDistance))
@@ -124,10 +196,57 @@ int gauze_main(int argc, char** argv)
     
         // behavior:
         ("capture", "Target capture distance", cxxopts::value<float>(captureZ))
+        ("capture-interval", "Min seconds between captures", cxxopts::value<double>(captureInterval))
+        ("max-velocity", "Only capture faces moving slower than this (m/s, 0 == unlimited)", cxxopts::value<float>(maxVelocity))
+        ("max-acceleration", "Only capture faces accelerating less than this (m/s^2, 0 == unlimited)", cxxopts::value<float>(maxAcceleration))
+        ("still-frames", "Consecutive frames under the motion limits before a capture", cxxopts::value<int>(stillFrames))
+        ("capture-roi", "Capture only the face region, padded by this fraction of its size (-1 == full frame)", cxxopts::value<float>(roiPadding))
+        ("capture-roi-size", "Rescale captured face regions to WxH", cxxopts::value<std::string>(sRoiSize))
+        ("capture-budget", "Max MB of capture data waiting to be processed (0 == unlimited)", cxxopts::value<double>(captureBudget))
+        ("budget-policy", "Over budget action: skip|eyes|backpressure", cxxopts::value<std::string>(sBudgetPolicy))
+        ("eye-quality", "Min eye crop quality score [0,1] to write (scores are saved as JSON, -1 == off)", cxxopts::value<float>(eyeQuality))
+        ("eye-model", "Refine captured eye crops with this EyeSegmenter model", cxxopts::value<std::string>(sEyeModel))
+        ("eye-threads", "Eye refinement worker threads", cxxopts::value<int>(eyeThreads))
+        ("eye-queue", "Max queued eye refinement jobs (extra jobs are dropped)", cxxopts::value<int>(eyeQueue))
+        ("eye-width", "Refine eye crops at this width (area resize), the masks stay at full resolution", cxxopts::value<int>(eyeWidth))
+        ("writer", "Capture output: auto|uring|threads|sync (sync == blocking writes on the worker)", cxxopts::value<std::string>(sWriter))
+        ("writer-depth", "Max io_uring writes in flight", cxxopts::value<int>(writerDepth))
+        ("writer-threads", "Writer thread pool size (pwrite fallback, open/close helpers with io_uring)", cxxopts::value<int>(writerThreads))
+        ("writer-queue", "Max pending capture files (the capture worker blocks when full)", cxxopts::value<int>(writerQueue))
+        ("direct", "Write captures with O_DIRECT (bypass the page cache)", cxxopts::value<bool>(writerSettings.direct))
+        ("dedupe", "Skip captures less than N bits (dHash distance) from the last one for the same face (-1 == off)", cxxopts::value<int>(dedupe))
         ("p,preview", "Preview window", cxxopts::value<bool>(doPreview))
+        ("log-rate", "Log the frame rate every N frames", cxxopts::value<int>(logRate))
+        ("control", "Control socket for live tuning and stats", cxxopts::value<std::string>(sControl))
+        ("metrics-port", "Serve Prometheus metrics on 127.0.0.1:<port>", cxxopts::value<int>(metricsPort))
+
+        // offline processing:
+        ("segments", "Process a video file as N concurrent time segments", cxxopts::value<int>(segmentCount))
+        ("compare", "Compare trackers in lockstep: optimized,simple,cpu-acf or config JSON files (--results gets the per-frame divergence)", cxxopts::value<std::string>(sCompare))
+        ("segment-warmup", "Warm-up frames decoded before each segment", cxxopts::value<int>(segmentWarmup))
+        ("start", "First source frame to process", cxxopts::value<int>(frameStart))
+        ("end", "Stop before this source frame (0 == all)", cxxopts::value<int>(frameEnd))
+        ("stride", "Process every N-th source frame", cxxopts::value<int>(frameStride))
+        ("sample-period", "Process one frame every N seconds (uses the source fps)", cxxopts::value<double>(samplePeriod))
+        ("seek", "Skip frames by seeking instead of grab()", cxxopts::value<bool>(doSeek))
+        ("realtime", "Release frames on the source clock, dropping frames while the tracker is busy", cxxopts::value<bool>(doRealtime))
+        ("realtime-fps", "Playback frame rate for --realtime (0 == source fps)", cxxopts::value<double>(realtimeFps))
+        ("luminance", "Feed the Y plane of raw NV12/I420 input to the tracker (GL_LUMINANCE)", cxxopts::value<bool>(doLuminance))
+
+        // instrumentation:
+        ("trace", "Per-frame timeline output (Chrome trace JSON)", cxxopts::value<std::string>(sTrace))
+        ("trace-capacity", "Max trace events per thread", cxxopts::value<int>(traceCapacity))
+        ("hw-counters", "Report CPU cycles, instructions, cache and branch misses per stage (Linux perf events)", cxxopts::value<bool>(doHardwareCounters))
+#if defined(DRISHTI_SDK_TEST_TRACK_ALLOCATIONS)
+        ("alloc-limit", "Fail if a steady state frame allocates more than N times", cxxopts::value<int>(allocLimit))
+        ("alloc-warmup", "Frames before the allocation limit is enforced", cxxopts::value<int>(allocWarmup))
+#endif
     ;
     // clang-format on
 
+    PerfReport::Settings perf;
+    PerfReport::addOptions(options, perf);
+
     options.parse(argc, argv);
     if ((argumentCount <= 1) || options.count("help"))
     {
@@ -137,6 +256,38 @@ int gauze_main(int argc, char** argv)
 
     auto logger = createLogger("drishti-face-test");
 
+    logRate = std::max(logRate, 1);
+
+    // clang-format off
+    const std::map<std::string, FaceTrackTest::BudgetPolicy> budgetPolicies =
+    {
+        { "skip", FaceTrackTest::BudgetPolicy::kSkip },
+        { "eyes", FaceTrackTest::BudgetPolicy::kEyesOnly },
+        { "backpressure", FaceTrackTest::BudgetPolicy::kBackpressure }
+    };
+    // clang-format on
+
+    if (!budgetPolicies.count(sBudgetPolicy))
+    {
+        logger->error("Unknown budget policy {} (skip|eyes|backpressure)", sBudgetPolicy);
+        return 1;
+    }
+
+    // clang-format off
+    const std::map<std::string, CaptureWriter::Backend> writerBackends =
+    {
+        { "auto", CaptureWriter::Backend::kAuto },
+        { "uring", CaptureWriter::Backend::kUring },
+        { "threads", CaptureWriter::Backend::kThreads }
+    };
+    // clang-format on
+
+    if (!writerBackends.count(sWriter) && (sWriter != "sync"))
+    {
+        logger->error("Unknown writer {} (auto|uring|threads|sync)", sWriter);
+        return 1;
+    }
+
     
     if (sInput.empty())
     {
@@ -170,6 +321,7 @@ int gauze_main(int argc, char** argv)
     if(!sConfig.empty())
     {
         from_json(sConfig, params);
+        ThreadTopology::get().load(sConfig);
     }
     else
     {
@@ -198,42 +350,307 @@ int gauze_main(int argc, char** argv)
         return 1;
     }
 
+    if (!sTrace.empty())
+    {
+        auto& trace = FrameTrace::get();
+        trace.setCapacity(static_cast<std::size_t>(std::max(traceCapacity, 1)));
+        trace.setEnabled(true);
+        trace.setThreadName("tracker");
+#if defined(SIGUSR1)
+        std::signal(SIGUSR1, requestTraceFlush);
+#endif
+    }
+
+    if (doHardwareCounters)
+    {
+        if (!HardwareCounters::enable())
+        {
+            logger->warn("Hardware counters are disabled: {}", HardwareCounters::getError());
+        }
+        else if (!HardwareCounters::getError().empty())
+        {
+            logger->warn("Hardware counters: {}", HardwareCounters::getError());
+        }
+    }
+
+    // This is the GL/tracker thread, threads created from here (including the
+    // SDK's) inherit its affinity:
+    ThreadTopology::get().setLogger(logger);
+    ThreadTopology::get().apply("tracker");
+
+    // Model load time covers the factory and tracker creation only:
+    auto loadStart = std::chrono::high_resolution_clock::now();
     FaceTrackerFactoryJson factory(sModels, "drishti-face-test");
+    const auto factoryTime = std::chrono::high_resolution_clock::now() - loadStart;
 
     // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
     // Allocate a video source and get the video frame dimensions:
     // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
 
-    std::shared_ptr<cv::VideoCapture> video = create(sInput);
+    std::shared_ptr<cv::VideoCapture> video = create(sInput, logger);
     if (!(video && video->isOpened()))
     {
        logger->error("Failed to create video source for {}", sInput);
        return 1;
     }
 
-    video->set(CV_CAP_PROP_FRAME_WIDTH, params.videoWidth);
-    video->set(CV_CAP_PROP_FRAME_HEIGHT, params.videoHeight);
+    if ((params.videoWidth > 0) && (params.videoHeight > 0))
+    {
+        video->set(CV_CAP_PROP_FRAME_WIDTH, params.videoWidth);
+        video->set(CV_CAP_PROP_FRAME_HEIGHT, params.videoHeight);
+    }
+
+    // Raw YUV input can skip the color conversion entirely (Y plane only):
+    const bool isYUV = VideoCaptureYUV::isYUV(sInput);
+    const bool isSynthetic = VideoCaptureSynthetic::isSynthetic(sInput);
+    if (doLuminance)
+    {
+        if (!(isYUV || isSynthetic))
+        {
+            logger->error("Luminance input requires a raw NV12/I420 or synthetic source: {}", sInput);
+            return 1;
+        }
+        video->set(CV_CAP_PROP_CONVERT_RGB, 0);
+    }
     
-    cv::Size size = getSize(*video);
-    if (size.area() == 0)
+    const cv::Size sourceSize = getSize(*video);
+    if (sourceSize.area() == 0)
     {
         logger->error("Failed to read a frame from device {}", sInput);
         return 1;
     }
 
-    if ((size.width != params.videoWidth) || (size.height != params.videoHeight))
+    if ((params.videoWidth == 0) && (params.videoHeight == 0))
     {
-        logger->error
-        (
-            "Failed to read a video frame with requested dimensions, received {}x{} expected {}x{}",
-            size.width,
-            size.height,
-            params.videoWidth,
-            params.videoHeight
-        );
-        return 1;
+        logger->info("Using the source resolution {}x{}", sourceSize.width, sourceSize.height);
+    }
+    else if ((sourceSize.width != params.videoWidth) || (sourceSize.height != params.videoHeight))
+    {
+        // The focal length is rescaled for sources with the configured aspect ratio:
+        const std::int64_t lhs = std::int64_t(sourceSize.width) * params.videoHeight;
+        const std::int64_t rhs = std::int64_t(sourceSize.height) * params.videoWidth;
+        if ((params.videoWidth <= 0) || (params.videoHeight <= 0) || (std::abs(lhs - rhs) * 100 > lhs))
+        {
+            logger->error
+            (
+                "Failed to read a video frame with requested dimensions, received {}x{} expected {}x{}",
+                sourceSize.width,
+                sourceSize.height,
+                params.videoWidth,
+                params.videoHeight
+            );
+            return 1;
+        }
+
+        logger->warn("Source is {}x{} (configured {}x{}): rescaling intrinsics", sourceSize.width, sourceSize.height, params.videoWidth, params.videoHeight);
+    }
+
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+    // Resize on ingest (trade resolution for throughput):
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+    cv::Size size = sourceSize; // tracker resolution
+    int reduction = 1;
+    if (params.ingestWidth > 0)
+    {
+        if (params.ingestWidth < sourceSize.width)
+        {
+            const double scale = static_cast<double>(params.ingestWidth) / sourceSize.width;
+            size = { params.ingestWidth, static_cast<int>(std::round(sourceSize.height * scale)) };
+
+            // Image lists can be decoded at 1/2, 1/4 or 1/8 size (JPEG DCT scaling):
+            if (auto list = std::dynamic_pointer_cast<VideoCaptureList>(video))
+            {
+                while ((reduction < 8) && (sourceSize.width / (reduction * 2) >= size.width))
+                {
+                    reduction *= 2;
+                }
+                list->setReduction(reduction);
+            }
+
+            logger->info("Resizing on ingest: {}x{} -> {}x{} (decode 1/{})", sourceSize.width, sourceSize.height, size.width, size.height, reduction);
+        }
+        else
+        {
+            logger->warn("Ignoring ingest width {} (source width {})", params.ingestWidth, sourceSize.width);
+        }
     }
     
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+    // Offline mode: process time segments of one video concurrently:
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+    if (segmentCount > 1)
+    {
+        const double count = video->get(cv::CAP_PROP_FRAME_COUNT);
+        if (VideoCaptureList::isList(sInput) || isYUV || isSynthetic || !(count > 0.0))
+        {
+            logger->error("Segment mode requires a video file with a known frame count: {}", sInput);
+            return 1;
+        }
+
+        if (segmentWarmup < params.minTrackHits)
+        {
+            logger->warn("Segment warm-up ({}) is shorter than minTrackHits ({})", segmentWarmup, params.minTrackHits);
+        }
+
+        video.reset(); // each segment worker opens its own source
+
+        const auto segments = SegmentRunner::split(static_cast<std::size_t>(count), segmentCount, std::max(segmentWarmup, 0));
+
+        SegmentRunner runner(logger, sInput, sModels, size, DFLT_TEXTURE_FORMAT);
+        const auto start = std::chrono::high_resolution_clock::now();
+        const auto results = runner(segments, [&](FaceResources& resources) { return createTracker(params, size, sourceSize, resources); });
+        const auto stop = std::chrono::high_resolution_clock::now();
+
+        const double elapsed = std::chrono::duration<double>(stop - start).count();
+        logger->info("Processed {} frames in {} segments: {} seconds ({} fps)", count, segments.size(), elapsed, count / elapsed);
+
+        if (!sResults.empty())
+        {
+            std::ofstream ofs(sResults);
+            if (!ofs)
+            {
+                logger->error("Failed to open results file {}", sResults);
+                return 1;
+            }
+            for (const auto& result : results)
+            {
+                ofs << result << "\n";
+            }
+        }
+
+        return 0;
+    }
+
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+    // Frame decimation (offline inputs):
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+    if (samplePeriod > 0.0)
+    {
+        const double fps = video->get(cv::CAP_PROP_FPS);
+        if (!(fps > 0.0))
+        {
+            logger->error("Time based sampling requires a source with a known frame rate: {}", sInput);
+            return 1;
+        }
+        frameStride = static_cast<int>(std::round(samplePeriod * fps));
+        logger->info("Sampling every {} seconds: stride {} at {} fps", samplePeriod, frameStride, fps);
+    }
+    frameStride = std::max(frameStride, 1);
+
+    // Index of the next source frame, skipped frames are never decoded:
+    std::size_t position = advance(*video, 0, static_cast<std::size_t>(std::max(frameStart, 0)), true);
+
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+    // Offline mode: compare tracker configurations on the same frames:
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+    if (!sCompare.empty())
+    {
+        if (doLuminance)
+        {
+            logger->error("Compare mode doesn't support luminance input");
+            return 1;
+        }
+
+        // Presets are applied to the current parameters, anything else is a config file:
+        std::vector<PipelineComparison::Variant> variants;
+        std::stringstream ss(sCompare);
+        for (std::string name; std::getline(ss, name, ',');)
+        {
+            Params variant = params;
+            if ((name == "optimized") || (name == "simple") || (name == "cpu-acf"))
+            {
+                variant.doSimplePipeline = (name != "optimized");
+                variant.doCpuAcf = (name == "cpu-acf");
+            }
+            else
+            {
+                try
+                {
+                    from_json(name, variant);
+                }
+                catch (const std::exception& e)
+                {
+                    logger->error("Failed to load compare configuration {}: {}", name, e.what());
+                    return 1;
+                }
+            }
+            variants.push_back({ name, [variant, size, sourceSize](FaceResources& resources) { return createTracker(variant, size, sourceSize, resources); } });
+        }
+
+        if (variants.size() < 2)
+        {
+            logger->error("Compare mode requires at least two configurations: {}", sCompare);
+            return 1;
+        }
+
+        std::ofstream ofs;
+        if (!sResults.empty())
+        {
+            ofs.open(sResults);
+            if (!ofs)
+            {
+                logger->error("Failed to open results file {}", sResults);
+                return 1;
+            }
+        }
+
+        // Same frame selection as the main loop (--start, --stride, --end):
+        bool started = false;
+        const auto source = [&](cv::Mat& image, std::size_t& index) {
+            if (started)
+            {
+                position = advance(*video, position, frameStride - 1, doSeek);
+            }
+            started = true;
+
+            if ((frameEnd > 0) && (position >= static_cast<std::size_t>(frameEnd)))
+            {
+                return false;
+            }
+
+            (*video) >> image;
+            index = position++;
+            return true;
+        };
+
+        PipelineComparison compare(logger, sModels, size, DFLT_TEXTURE_FORMAT);
+        compare(source, variants, ofs.is_open() ? &ofs : nullptr);
+        return 0;
+    }
+
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+    // Real-time playback (paced source w/ frame drops):
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+    const std::size_t first = position;
+    if (doRealtime)
+    {
+        realtimeFps = (realtimeFps > 0.0) ? realtimeFps : video->get(cv::CAP_PROP_FPS);
+        if (!(realtimeFps > 0.0))
+        {
+            logger->error("Real-time playback requires a source with a known frame rate (or --realtime-fps): {}", sInput);
+            return 1;
+        }
+
+        if (frameStride > 1)
+        {
+            logger->error("Real-time playback doesn't support frame decimation (--stride, --sample-period)");
+            return 1;
+        }
+
+        if ((frameEnd > 0) && (static_cast<std::size_t>(frameEnd) <= first))
+        {
+            logger->error("Empty frame range for real-time playback: [{},{})", first, frameEnd);
+            return 1;
+        }
+
+        logger->info("Real-time playback at {} fps", realtimeFps);
+    }
+
     // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
     // Create an OpenGL context (w/ optional window):
     // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
@@ -259,34 +676,17 @@ int gauze_main(int argc, char** argv)
     // Instantiate face tracking callbacks:
     // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
 
-    std::shared_ptr<drishti::sdk::FaceTracker> tracker;
-
-    { // Configure the face tracker parameters:
-        drishti::sdk::Vec2f p(size.width / 2, size.height / 2);
-        drishti::sdk::SensorModel::Intrinsic intrinsic(p, params.focalLength, { size.width, size.height });
-        drishti::sdk::SensorModel::Extrinsic extrinsic(drishti::sdk::Matrix33f::eye());
-        drishti::sdk::SensorModel sensor(intrinsic, extrinsic);
-
-        drishti::sdk::Context context(sensor);
-        context.setDoSingleFace(!params.multiFace);                    // only detect 1 face per frame
-        context.setMinDetectionDistance(params.minDetectionDistance);  // min distance
-        context.setMaxDetectionDistance(params.maxDetectionDistance);  // max distance
-        context.setFaceFinderInterval(params.faceFinderInterval);      // detect on every frame ...
-        context.setAcfCalibration(params.acfCalibration);              // adjust detection sensitivity
-        context.setRegressorCropScale(params.regressorCropScale);      // regressor crop scale
-        context.setMinTrackHits(params.minTrackHits);                  // # of hits before a new track is started
-        context.setMaxTrackMisses(params.maxTrackMisses);              // # of misses before the track is abandoned
-        context.setMinFaceSeparation(params.minFaceSeparation);        // min face separation
-        context.setDoOptimizedPipeline(!params.doSimplePipeline);      // configure optimized pipeline
-        context.setDoAnnotation(params.doAnnotation);                  // add default annotations for quick preview
-        context.setDoCpuACF(params.doCpuAcf);                          // available only if using the simple pipeline
-        
-        tracker = std::make_shared<drishti::sdk::FaceTracker>(&context, factory.factory);
-        if (!tracker)
-        {
-            logger->error("Failed to create face tracker");
-            return 1;
-        }
+    loadStart = std::chrono::high_resolution_clock::now();
+    std::shared_ptr<drishti::sdk::FaceTracker> tracker = createTracker(params, size, sourceSize, factory.factory);
+    if (!tracker)
+    {
+        logger->error("Failed to create face tracker");
+        return 1;
+    }
+
+    {
+        const auto loadStop = std::chrono::high_resolution_clock::now();
+        PipelineStats::get().modelLoadTime = std::chrono::duration<double>(factoryTime + (loadStop - loadStart)).count();
     }
 
     // Register callbacks:
@@ -301,20 +701,332 @@ int gauze_main(int argc, char** argv)
     {
         // Set a capture volume on the camera's optical axis with a 1/3 meter radius
         // and be sure not to trigger a capture more than once every 8.0 seconds.
-        callbacks.setCaptureSphere({ { 0.f, 0.f, captureZ } }, 0.33f, 8.0);
+        callbacks.setCaptureSphere({ { 0.f, 0.f, captureZ } }, 0.33f, captureInterval);
+    }
+
+    if (roiPadding >= 0.f)
+    {
+        cv::Size roiSize;
+        if (!sRoiSize.empty())
+        {
+            char x = 0;
+            std::stringstream geometry(sRoiSize);
+            if (!(geometry >> roiSize.width >> x >> roiSize.height) || (x != 'x') || (roiSize.width <= 0) || (roiSize.height <= 0))
+            {
+                logger->error("Invalid capture ROI size (expected WxH): {}", sRoiSize);
+                return 1;
+            }
+        }
+        callbacks.setCaptureRoi(roiPadding, roiSize);
+    }
+
+    if ((maxVelocity > 0.f) || (maxAcceleration > 0.f))
+    {
+        callbacks.setMotionLimits(maxVelocity, maxAcceleration, std::max(stillFrames, 1));
+    }
+
+    if (captureBudget > 0.0)
+    {
+        const auto bytes = static_cast<std::size_t>(captureBudget * 1024.0 * 1024.0);
+        callbacks.setCaptureBudget(bytes, budgetPolicies.at(sBudgetPolicy));
+    }
+
+    if (dedupe >= 0)
+    {
+        callbacks.setDedupe(std::min(dedupe, 64));
+    }
+
+    if (eyeQuality >= 0.f)
+    {
+        callbacks.setEyeQuality(eyeQuality);
+    }
+
+    // Encoded captures are written in the background (bursts are absorbed by the writer queue):
+    std::shared_ptr<CaptureWriter> writer;
+    if (!sOutput.empty() && (sWriter != "sync"))
+    {
+        writerSettings.backend = writerBackends.at(sWriter);
+        writerSettings.depth = static_cast<std::size_t>(std::max(writerDepth, 1));
+        writerSettings.threads = ThreadTopology::get().getSize("writer", std::max(writerThreads, 1));
+        writerSettings.queue = static_cast<std::size_t>(std::max(writerQueue, 1));
+        writer = std::make_shared<CaptureWriter>(logger, writerSettings);
+        callbacks.setWriter(writer);
+        logger->info("Capture output: {} writer", writer->getBackend());
+    }
+
+    // Optional high accuracy eye models for the captured eye crops (off the tracker thread):
+    std::shared_ptr<EyeRefiner> refiner;
+    if (!sEyeModel.empty())
+    {
+        const auto threads = ThreadTopology::get().getSize("refine", std::max(eyeThreads, 1));
+        refiner = std::make_shared<EyeRefiner>(logger, sEyeModel, threads, std::max(eyeQueue, 1), std::max(eyeWidth, 0));
+        callbacks.setEyeHandler([refiner, logger](const cv::Mat& eyes, const std::string& prefix) {
+            if (!refiner->post(eyes, prefix))
+            {
+                logger->warn("Eye refinement queue is full, dropping {}", prefix);
+            }
+        });
     }
 
     tracker->add(callbacks.table);
 
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+    // Optional Prometheus metrics endpoint:
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+    std::shared_ptr<MetricsServer> metrics;
+    if (metricsPort > 0)
+    {
+        metrics = std::make_shared<MetricsServer>(logger);
+
+        // clang-format off
+        metrics->add([&callbacks, refiner](std::ostream& os)
+        {
+            os << "# HELP drishti_worker_queue_depth Capture jobs posted but not yet processed.\n";
+            os << "# TYPE drishti_worker_queue_depth gauge\n";
+            os << "drishti_worker_queue_depth " << callbacks.getQueueDepth() << "\n";
+            if (refiner)
+            {
+                os << "# HELP drishti_refine_queue_depth Eye refinement jobs posted but not yet processed.\n";
+                os << "# TYPE drishti_refine_queue_depth gauge\n";
+                os << "drishti_refine_queue_depth " << refiner->depth() << "\n";
+                os << "# HELP drishti_refine_dropped_jobs_total Eye refinement jobs dropped by the queue.\n";
+                os << "# TYPE drishti_refine_dropped_jobs_total counter\n";
+                os << "drishti_refine_dropped_jobs_total " << refiner->dropped() << "\n";
+            }
+        });
+        // clang-format on
+
+        if (!metrics->start(metricsPort))
+        {
+            return 1;
+        }
+    }
+
+    // The tracker output can lag its input, so results are matched to the
+    // submitted frames in order (the paced latency ends at the output):
+    struct Submitted
+    {
+        std::size_t index;
+        FramePacer::Clock::time_point scheduled;
+    };
+    std::deque<Submitted> submitted;
+
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+    // Optional control socket for live tuning and stats:
+    // :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+    // Changes requested by the control thread are applied here on the frame
+    // loop thread, between frames.  Tracker parameter changes rebuild the
+    // tracker from the cached models (the callbacks and output state persist).
+    TaskQueue tasks;
+    std::shared_ptr<ControlServer> control;
+    if (!sControl.empty())
+    {
+        auto rebuild = [&](const Params& updated) {
+            const auto start = std::chrono::high_resolution_clock::now();
+
+            // The current tracker has already consumed the model streams, so
+            // they can be rewound for the replacement, which is swapped in
+            // only once it has been created (a failure keeps the old one):
+            factory.reset();
+            std::shared_ptr<drishti::sdk::FaceTracker> replacement = createTracker(updated, size, sourceSize, factory.factory);
+            if (!replacement)
+            {
+                throw std::runtime_error("failed to rebuild the face tracker");
+            }
+            replacement->add(callbacks.table);
+            tracker.swap(replacement);
+            params = updated;
+
+            // Frames still in the old tracker's pipeline will never produce results:
+            submitted.clear();
+
+            const auto stop = std::chrono::high_resolution_clock::now();
+            logger->info("Rebuilt face tracker in {} seconds", std::chrono::duration<double>(stop - start).count());
+        };
+
+        control = std::make_shared<ControlServer>(logger);
+        addControlCommands(*control, tasks, rebuild, params);
+
+        // clang-format off
+        control->add("stats", "", [&](const ControlServer::Arguments& args, std::ostream& os)
+        {
+            PipelineStats::get().report(os);
+            os << "worker.depth " << callbacks.getQueueDepth() << "\n";
+            if (refiner)
+            {
+                os << "refine.depth " << refiner->depth() << "\n";
+                os << "refine.dropped " << refiner->dropped() << "\n";
+            }
+        });
+
+        control->add("capture", "<x> <y> <z> [radius] : set the capture sphere (meters)", [&](const ControlServer::Arguments& args, std::ostream& os)
+        {
+            if (args.size() < 3)
+            {
+                throw std::runtime_error("capture requires <x> <y> <z> [radius]");
+            }
+            const std::array<float, 3> center{ { std::stof(args[0]), std::stof(args[1]), std::stof(args[2]) } };
+            const float radius = (args.size() > 3) ? std::stof(args[3]) : 0.33f;
+            os << tasks.call([&callbacks, &captureInterval, center, radius]() {
+                callbacks.setCaptureSphere(center, radius, captureInterval);
+                return std::string();
+            });
+        });
+
+        control->add("interval", "<seconds> : set the min time between captures", [&](const ControlServer::Arguments& args, std::ostream& os)
+        {
+            if (args.size() != 1)
+            {
+                throw std::runtime_error("interval requires <seconds>");
+            }
+            const double seconds = std::stod(args[0]);
+            os << tasks.call([&callbacks, &captureInterval, seconds]() {
+                captureInterval = seconds;
+                callbacks.setCaptureInterval(seconds);
+                return std::string();
+            });
+        });
+
+        control->add("log-rate", "<frames> : log the frame rate every N frames", [&](const ControlServer::Arguments& args, std::ostream& os)
+        {
+            if (args.size() != 1)
+            {
+                throw std::runtime_error("log-rate requires <frames>");
+            }
+            const int rate = std::max(std::stoi(args[0]), 1);
+            os << tasks.call([&logRate, rate]() {
+                logRate = rate;
+                return std::string();
+            });
+        });
+
+        control->add("preview", "<on|off> : toggle the preview display", [&](const ControlServer::Arguments& args, std::ostream& os)
+        {
+            if ((args.size() != 1) || !((args[0] == "on") || (args[0] == "off")))
+            {
+                throw std::runtime_error("preview requires <on|off>");
+            }
+            if (!callbacks.hasPreview())
+            {
+                throw std::runtime_error("no preview window (restart with --preview)");
+            }
+            const bool enabled = (args[0] == "on");
+            os << tasks.call([&callbacks, enabled]() {
+                callbacks.setPreviewEnabled(enabled);
+                return std::string();
+            });
+        });
+
+        control->add("trace", "[filename] : write the frame timeline now", [&](const ControlServer::Arguments& args, std::ostream& os)
+        {
+            const std::string filename = args.empty() ? sTrace : args[0];
+            if (!FrameTrace::get().isEnabled() || filename.empty())
+            {
+                throw std::runtime_error("tracing is not enabled (restart with --trace)");
+            }
+            if (!FrameTrace::get().flush(filename))
+            {
+                throw std::runtime_error("failed to write " + filename);
+            }
+        });
+        // clang-format on
+
+        if (!control->start(sControl))
+        {
+            return 1;
+        }
+    }
+
     float resolution = 1.0f;
+    FrameIngest ingest(size, doLuminance); // pooled resize + color conversion buffers
+    logger->info("Ingest: {} bytes per frame ({} for BGRA)", size.area() * (doLuminance ? 1 : 4), size.area() * 4);
     const auto tic = std::chrono::high_resolution_clock::now();
     std::size_t index = 0;
+    PerfReport report;
+
+    std::shared_ptr<FramePacer> pacer; // started with the frame loop
+    FramePacer::Frame paced;           // buffer is recycled by the pacer
+
+    // Steady state allocations per frame on this (tracker) thread:
+    std::uint64_t maxFrameAllocations = 0;
+    bool allocFailed = false;
+
+    std::ofstream results;
+    if (!sResults.empty())
+    {
+        results.open(sResults);
+        if (!results)
+        {
+            logger->error("Failed to open results file {}", sResults);
+            return 1;
+        }
+
+    }
+
+    // Results are matched to the submitted frames in order (see above):
+    callbacks.setResultHandler([&](const drishti_face_tracker_result_t& faces, double timestamp) {
+        if (submitted.empty())
+        {
+            return;
+        }
+
+        const auto frame = submitted.front();
+        submitted.pop_front();
+        if (pacer)
+        {
+            pacer->done(frame.scheduled);
+        }
+        if (results.is_open())
+        {
+            results << FrameResult(frame.index, timestamp, faces) << "\n";
+        }
+    });
     
     // clang-format off
     std::function<bool()> process = [&]()
     {
+        const auto frameTic = std::chrono::high_resolution_clock::now();
+        const auto frameAllocations = AllocationTracker::getThreadAllocations();
+
+        // Apply any pending runtime changes (i.e., from the control socket):
+        tasks.poll();
+
+        // Tag everything that happens for this frame (on any thread) with its ID:
+        FrameTrace::setFrame(index);
+
         cv::Mat image;
-        (*video) >> image;
+        {
+            ScopedStage stage(PipelineStage::kRead);
+            if (pacer)
+            {
+                // Frames released while the tracker was busy were dropped by the pacer:
+                if (!pacer->pop(paced))
+                {
+                    logger->info("Reached the end of the paced source at frame {}", position);
+                    return false;
+                }
+                image = paced.image;
+                position = first + paced.index + 1;
+            }
+            else
+            {
+                if (index > 0)
+                {
+                    position = advance(*video, position, frameStride - 1, doSeek);
+                }
+
+                if ((frameEnd > 0) && (position >= static_cast<std::size_t>(frameEnd)))
+                {
+                    logger->info("Reached the end of the requested range at frame {}", position);
+                    return false;
+                }
+
+                (*video) >> image;
+                position++;
+            }
+        }
 
         if (image.empty())
         {
@@ -324,15 +1036,17 @@ int gauze_main(int argc, char** argv)
 
       //  cv::imwrite("c:/tmp/frame.png", image); // 1920 / fx =  26 / 20; fx = 1920 * 20/26
 
-        if (size.area() && (size != image.size()))
+        // Reduced decoding rounds the frame size (the ingest resize absorbs it):
+        if ((reduction == 1) && (sourceSize != image.size()))
         {
-            logger->error("Frame dimensions must be consistent: {}{}", size.width, size.height);
+            logger->error("Frame dimensions must be consistent: {}{}", sourceSize.width, sourceSize.height);
         }
 
-        if (image.channels() == 3)
         {
-            cv::cvtColor(image, image, cv::COLOR_BGR2BGRA);
+            ScopedStage stage(PipelineStage::kConvert);
+            image = ingest(image);
         }
+        PipelineStats::get().bytesIngested += image.total() * image.elemSize();
 
         if (doPreview)
         { // Update window properties (if used):
@@ -341,23 +1055,127 @@ int gauze_main(int argc, char** argv)
         }
 
         // Register callback:
-        drishti::sdk::VideoFrame frame({ image.cols, image.rows }, image.ptr(), true, 0, DFLT_TEXTURE_FORMAT);
-        (*tracker)(frame);
+        const GLenum textureFormat = (image.channels() == 1) ? GL_LUMINANCE : DFLT_TEXTURE_FORMAT;
+        drishti::sdk::VideoFrame frame({ image.cols, image.rows }, image.ptr(), true, 0, textureFormat);
+        submitted.push_back({ index, paced.scheduled });
+        {
+            ScopedStage stage(PipelineStage::kTrack);
+            (*tracker)(frame);
+        }
+
+        if (gDoTraceFlush.exchange(false) && !sTrace.empty())
+        {
+            logger->info("Writing trace {}", sTrace);
+            FrameTrace::get().flush(sTrace);
+        }
+
+        if (AllocationTracker::isEnabled())
+        {
+            AllocationTracker::sampleRss();
+            const auto allocations = AllocationTracker::getThreadAllocations() - frameAllocations;
+            if (index >= static_cast<std::size_t>(std::max(allocWarmup, 0)))
+            {
+                maxFrameAllocations = std::max(maxFrameAllocations, allocations);
+                if ((allocLimit >= 0) && (allocations > static_cast<std::uint64_t>(allocLimit)))
+                {
+                    logger->error("Frame {} made {} allocations (limit {})", index, allocations, allocLimit);
+                    allocFailed = true;
+                    return false;
+                }
+            }
+        }
+
+        PipelineStats::get().addFrame();
 
         { // Comnpute simple/global FPS
             const auto toc = std::chrono::high_resolution_clock::now();
             const double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(toc - tic).count();
+            report.add(std::chrono::duration<double>(toc - frameTic).count());
+            report.setElapsed(elapsed);
             const double fps = static_cast<double>(index + 1) / elapsed;
-            logger->info("Frame: {} fps = {}", index++, fps);
+            if ((index % logRate) == 0)
+            {
+                logger->info("Frame: {} fps = {}", index, fps);
+            }
+            index++;
         }
 
         return true;
     };
     // clang-format on
 
+    if (doRealtime)
+    {
+        // The pacer clock starts here (after model loading) so early frames aren't dropped:
+        const std::size_t count = (frameEnd > 0) ? (static_cast<std::size_t>(frameEnd) - first) : 0;
+        pacer = std::make_shared<FramePacer>(video, realtimeFps, count);
+    }
+
     (*glContext)(process);
 
-    return 0;
+    if (pacer)
+    {
+        pacer->report(*logger);
+        pacer.reset(); // stop reading
+    }
+
+    if (writer)
+    {
+        // Captures queued on the worker are handed to the writer first:
+        callbacks.flush();
+        writer->flush();
+        writer->report(*logger);
+    }
+
+    if (control)
+    {
+        control->stop();
+    }
+
+    if (metrics)
+    {
+        metrics->stop();
+    }
+
+    if (!sTrace.empty())
+    {
+        if (!FrameTrace::get().flush(sTrace))
+        {
+            logger->error("Failed to write trace {}", sTrace);
+        }
+        else if (const auto dropped = FrameTrace::get().dropped())
+        {
+            logger->warn("Trace buffers were full, {} events were dropped", dropped);
+        }
+    }
+
+    if (HardwareCounters::isEnabled())
+    {
+        std::stringstream ss;
+        HardwareCounters::report(ss);
+        for (std::string line; std::getline(ss, line);)
+        {
+            logger->info("{}", line);
+        }
+    }
+
+    if (AllocationTracker::isEnabled())
+    {
+        std::stringstream ss;
+        AllocationTracker::report(ss);
+        for (std::string line; std::getline(ss, line);)
+        {
+            logger->info("{}", line);
+        }
+        logger->info("alloc.frame.max {} (after {} warm-up frames)", maxFrameAllocations, allocWarmup);
+
+        if (allocFailed)
+        {
+            return 1;
+        }
+    }
+
+    return report.finish(perf, *logger);
 }
 
 #if !defined(DRISHTI_SDK_TEST_BUILD_TESTS)
@@ -390,9 +1208,13 @@ static std::shared_ptr<spdlog::logger> createLogger(const char* name)
     return logger;
 }
 
-static std::shared_ptr<cv::VideoCapture> create(const std::string& filename)
+static std::shared_ptr<cv::VideoCapture> create(const std::string& filename, std::shared_ptr<spdlog::logger>& logger)
 {
-    if (filename.find_first_not_of("0123456789") == std::string::npos)
+    if (VideoCaptureSynthetic::isSynthetic(filename))
+    {
+        return std::make_shared<VideoCaptureSynthetic>(filename);
+    }
+    else if (filename.find_first_not_of("0123456789") == std::string::npos)
     {
         auto ptr = std::make_shared<cv::VideoCapture>(std::stoi(filename));
         if (ptr && !ptr->isOpened())
@@ -401,9 +1223,13 @@ static std::shared_ptr<cv::VideoCapture> create(const std::string& filename)
         }
         return ptr;
     }
-    else if (filename.find(".txt") != std::string::npos)
+    else if (VideoCaptureList::isList(filename))
+    {
+        return std::make_shared<VideoCaptureList>(filename, logger);
+    }
+    else if (VideoCaptureYUV::isYUV(filename))
     {
-        return std::make_shared<VideoCaptureList>(filename);
+        return std::make_shared<VideoCaptureYUV>(filename);
     }
     else
     {
@@ -411,6 +1237,26 @@ static std::shared_ptr<cv::VideoCapture> create(const std::string& filename)
     }
 }
 
+// Skip frames without decoding them (grab() w/o retrieve() or a seek):
+static std::size_t advance(cv::VideoCapture& video, std::size_t position, std::size_t count, bool doSeek)
+{
+    if (count == 0)
+    {
+        return position;
+    }
+
+    if (doSeek && video.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(position + count)))
+    {
+        return position + count;
+    }
+
+    for (std::size_t i = 0; (i < count) && video.grab(); i++)
+    {
+        position++;
+    }
+    return position;
+}
+
 static cv::Size getSize(const cv::VideoCapture& video)
 {
     // clang-format off
@@ -422,12 +1268,148 @@ static cv::Size getSize(const cv::VideoCapture& video)
     // clang-format on
 };
 
+// The focal length is specified at videoWidth x videoHeight (the source resolution
+// if they aren't configured) and is rescaled to the tracker resolution:
+static std::shared_ptr<drishti::sdk::FaceTracker> createTracker(const Params& params, const cv::Size& size, const cv::Size& sourceSize, FaceResources& resources)
+{
+    const int reference = (params.videoWidth > 0) ? params.videoWidth : sourceSize.width;
+    const float scale = (reference > 0) ? static_cast<float>(size.width) / reference : 1.f;
+    drishti::sdk::Vec2f p(size.width / 2, size.height / 2);
+    drishti::sdk::SensorModel::Intrinsic intrinsic(p, params.focalLength * scale, { size.width, size.height });
+    drishti::sdk::SensorModel::Extrinsic extrinsic(drishti::sdk::Matrix33f::eye());
+    drishti::sdk::SensorModel sensor(intrinsic, extrinsic);
+
+    drishti::sdk::Context context(sensor);
+    context.setDoSingleFace(!params.multiFace);                    // only detect 1 face per frame
+    context.setMinDetectionDistance(params.minDetectionDistance);  // min distance
+    context.setMaxDetectionDistance(params.maxDetectionDistance);  // max distance
+    context.setFaceFinderInterval(params.faceFinderInterval);      // detect on every frame ...
+    context.setAcfCalibration(params.acfCalibration);              // adjust detection sensitivity
+    context.setRegressorCropScale(params.regressorCropScale);      // regressor crop scale
+    context.setMinTrackHits(params.minTrackHits);                  // # of hits before a new track is started
+    context.setMaxTrackMisses(params.maxTrackMisses);              // # of misses before the track is abandoned
+    context.setMinFaceSeparation(params.minFaceSeparation);        // min face separation
+    context.setDoOptimizedPipeline(!params.doSimplePipeline);      // configure optimized pipeline
+    context.setDoAnnotation(params.doAnnotation);                  // add default annotations for quick preview
+    context.setDoCpuACF(params.doCpuAcf);                          // available only if using the simple pipeline
+
+    return std::make_shared<drishti::sdk::FaceTracker>(&context, resources);
+}
+
+// Tracker parameters that can be changed at runtime (by JSON name):
+struct ParamTable
+{
+    ParamTable(Params& params)
+    {
+        // clang-format off
+        floats =
+        {
+            { "focalLength", &params.focalLength },
+            { "minDetectionDistance", &params.minDetectionDistance },
+            { "maxDetectionDistance", &params.maxDetectionDistance },
+            { "faceFinderInterval", &params.faceFinderInterval },
+            { "acfCalibration", &params.acfCalibration },
+            { "regressorCropScale", &params.regressorCropScale },
+            { "minFaceSeparation", &params.minFaceSeparation }
+        };
+        ints =
+        {
+            { "minTrackHits", &params.minTrackHits },
+            { "maxTrackMisses", &params.maxTrackMisses }
+        };
+        bools =
+        {
+            { "multiFace", &params.multiFace },
+            { "doSimplePipeline", &params.doSimplePipeline },
+            { "doAnnotation", &params.doAnnotation },
+            { "doCpuAcf", &params.doCpuAcf }
+        };
+        // clang-format on
+    }
+
+    void set(const std::string& name, const std::string& value)
+    {
+        if (floats.count(name))
+        {
+            *floats[name] = std::stof(value);
+        }
+        else if (ints.count(name))
+        {
+            *ints[name] = std::stoi(value);
+        }
+        else if (bools.count(name))
+        {
+            if ((value != "true") && (value != "false") && (value != "1") && (value != "0"))
+            {
+                throw std::runtime_error("expected a boolean value (true|false) for " + name);
+            }
+            *bools[name] = ((value == "true") || (value == "1"));
+        }
+        else
+        {
+            throw std::runtime_error("unknown parameter " + name);
+        }
+    }
+
+    void print(std::ostream& os) const
+    {
+        for (const auto& p : floats)
+        {
+            os << p.first << " " << *p.second << "\n";
+        }
+        for (const auto& p : ints)
+        {
+            os << p.first << " " << *p.second << "\n";
+        }
+        for (const auto& p : bools)
+        {
+            os << p.first << " " << (*p.second ? "true" : "false") << "\n";
+        }
+    }
+
+    std::map<std::string, float*> floats;
+    std::map<std::string, int*> ints;
+    std::map<std::string, bool*> bools;
+};
+
+static void addControlCommands(ControlServer& control, TaskQueue& tasks, std::function<void(const Params&)> rebuild, Params& params)
+{
+    // clang-format off
+    control.add("params", ": list the tracker parameters", [&tasks, &params](const ControlServer::Arguments& args, std::ostream& os)
+    {
+        os << tasks.call([&params]() {
+            std::stringstream ss;
+            ParamTable(params).print(ss);
+            return ss.str();
+        });
+    });
+
+    control.add("set", "<name> <value> : change a tracker parameter (rebuilds the tracker)", [&tasks, &params, rebuild](const ControlServer::Arguments& args, std::ostream& os)
+    {
+        if (args.size() != 2)
+        {
+            throw std::runtime_error("set requires <name> <value>");
+        }
+
+        const std::string name = args[0], value = args[1];
+        os << tasks.call([&params, rebuild, name, value]() {
+            Params updated = params;
+            ParamTable(updated).set(name, value);
+            if (updated.minDetectionDistance > updated.maxDetectionDistance)
+            {
+                throw std::runtime_error("search range requires minDetectionDistance < maxDetectionDistance");
+            }
+            rebuild(updated);
+            return std::string();
+        });
+    });
+    // clang-format on
+}
+
 #include <nlohmann/json.hpp> // nlohman-json
 
 static void from_json(const nlohmann::json &json, Params &params)
 {
-    params.videoWidth = json.at("videoWidth").get<float>();
-    params.videoHeight = json.at("videoHeight").get<float>();
     params.focalLength = json.at("focalLength").get<float>();
     params.multiFace  = json.at("multiFace").get<bool>();
     params.minDetectionDistance = json.at("minDetectionDistance").get<float>();
@@ -441,6 +1423,17 @@ static void from_json(const nlohmann::json &json, Params &params)
     params.doSimplePipeline = json.at("doSimplePipeline").get<bool>();
     params.doAnnotation = json.at("doAnnotation").get<bool>();
     params.doCpuAcf = json.at("doCpuAcf").get<bool>();
+
+    // optional (the source resolution is used when the video size is omitted):
+    if (json.count("videoWidth") && json.count("videoHeight"))
+    {
+        params.videoWidth = json.at("videoWidth").get<int>();
+        params.videoHeight = json.at("videoHeight").get<int>();
+    }
+    if (json.count("ingestWidth"))
+    {
+        params.ingestWidth = json.at("ingestWidth").get<int>();
+    }
 }
 
 static void from_json(const std::string &filename, Params &params)
@@ -475,7 +1468,8 @@ static void to_json(nlohmann::json &json, const Params &params)
         {"minFaceSeparation", params.minFaceSeparation},
         {"doSimplePipeline", params.doSimplePipeline},
         {"doAnnotation", params.doAnnotation},
-        {"doCpuAcf", params.doCpuAcf}
+        {"doCpuAcf", params.doCpuAcf},
+        {"ingestWidth", params.ingestWidth}
     };
 }
 
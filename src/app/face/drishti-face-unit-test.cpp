@@ -0,0 +1,313 @@
+/*!
+  @file   drishti-face-unit-test.cpp
+  @author David Hirvonen
+  @brief  Unit tests for the application side capture logic (synthetic inputs).
+
+  \copyright Copyright 2018 Elucideye, Inc. All rights reserved.
+  \license{This project is released under the 3 Clause BSD License.}
+
+  These components are pure functions of their inputs, so they are tested
+  without models, video or an OpenGL context.  Each test returns the number
+  of failed checks, and the failures are printed with their line numbers.
+
+*/
+
+#include "CaptureDedupe.h"
+#include "MotionGate.h"
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define CHECK(condition) check((condition), #condition, __LINE__, failures)
+
+static void check(bool condition, const char* text, int line, int& failures)
+{
+    if (!condition)
+    {
+        std::cerr << "line " << line << ": CHECK(" << text << ") failed" << std::endl;
+        failures++;
+    }
+}
+
+// 9x8 gray image (the dHash thumbnail size) with rows that increase or decrease:
+static cv::Mat1b createRamp(const std::vector<bool>& increasing)
+{
+    cv::Mat1b image(8, 9);
+    for (int y = 0; y < image.rows; y++)
+    {
+        for (int x = 0; x < image.cols; x++)
+        {
+            image(y, x) = static_cast<std::uint8_t>(increasing[y] ? (x * 16) : (255 - x * 16));
+        }
+    }
+    return image;
+}
+
+// CaptureDedupe: {
+
+static int testDedupeHash()
+{
+    int failures = 0;
+
+    // Each bit is set where a pixel is darker than its right neighbor:
+    CHECK(CaptureDedupe::hash(createRamp(std::vector<bool>(8, true))) == ~std::uint64_t(0));
+    CHECK(CaptureDedupe::hash(createRamp(std::vector<bool>(8, false))) == 0);
+    CHECK(CaptureDedupe::hash(cv::Mat1b(8, 9, std::uint8_t(128))) == 0); // equal isn't darker
+
+    // The first row is the most significant byte:
+    std::vector<bool> rows(8, false);
+    rows[0] = true;
+    CHECK(CaptureDedupe::hash(createRamp(rows)) == 0xff00000000000000ull);
+
+    // Color images hash like their gray version:
+    cv::Mat3b bgr(8, 9);
+    cv::Mat1b gray = createRamp(std::vector<bool>(8, true));
+    for (int y = 0; y < bgr.rows; y++)
+    {
+        for (int x = 0; x < bgr.cols; x++)
+        {
+            bgr(y, x) = cv::Vec3b(gray(y, x), gray(y, x), gray(y, x));
+        }
+    }
+    CHECK(CaptureDedupe::hash(bgr) == ~std::uint64_t(0));
+    CHECK(CaptureDedupe::hash(cv::Mat()) == 0);
+
+    CHECK(CaptureDedupe::distance(0, 0) == 0);
+    CHECK(CaptureDedupe::distance(0, ~std::uint64_t(0)) == 64);
+    CHECK(CaptureDedupe::distance(0xf0, 0x0f) == 8);
+
+    return failures;
+}
+
+static int testDedupeThreshold()
+{
+    int failures = 0;
+
+    const std::array<float, 3> position{ { 0.f, 0.f, 1.f } };
+    const cv::Mat1b reference = createRamp(std::vector<bool>(8, true));
+
+    std::vector<bool> rows(8, true);
+    rows[0] = false;
+    const cv::Mat1b changed = createRamp(rows); // 8 bits from the reference
+
+    // A duplicate is strictly closer than the threshold:
+    const auto isDuplicate = [&](int threshold) {
+        CaptureDedupe dedupe(threshold);
+        dedupe.isDuplicate(position, CaptureDedupe::kFrame, reference);
+        return dedupe.isDuplicate(position, CaptureDedupe::kFrame, changed);
+    };
+    CHECK(!isDuplicate(8));
+    CHECK(isDuplicate(9));
+
+    // 1 only suppresses identical hashes, 0 (or less) disables the check:
+    {
+        CaptureDedupe dedupe(1);
+        CHECK(!dedupe.isDuplicate(position, CaptureDedupe::kFrame, reference));
+        CHECK(dedupe.isDuplicate(position, CaptureDedupe::kFrame, reference));
+        CHECK(!dedupe.isDuplicate(position, CaptureDedupe::kFrame, changed));
+    }
+    for (int threshold : { 0, -1 })
+    {
+        CaptureDedupe dedupe(threshold);
+        CHECK(!dedupe.isDuplicate(position, CaptureDedupe::kFrame, reference));
+        CHECK(!dedupe.isDuplicate(position, CaptureDedupe::kFrame, reference));
+    }
+
+    // Frames and eye crops have separate references:
+    {
+        CaptureDedupe dedupe(1);
+        CHECK(!dedupe.isDuplicate(position, CaptureDedupe::kFrame, reference));
+        CHECK(!dedupe.isDuplicate(position, CaptureDedupe::kEyes, reference));
+        CHECK(dedupe.isDuplicate(position, CaptureDedupe::kEyes, reference));
+    }
+
+    // Empty images are never duplicates (and don't replace the reference):
+    {
+        CaptureDedupe dedupe(1);
+        CHECK(!dedupe.isDuplicate(position, CaptureDedupe::kFrame, reference));
+        CHECK(!dedupe.isDuplicate(position, CaptureDedupe::kFrame, cv::Mat()));
+        CHECK(dedupe.isDuplicate(position, CaptureDedupe::kFrame, reference));
+    }
+
+    return failures;
+}
+
+static int testDedupeFaces()
+{
+    int failures = 0;
+
+    const cv::Mat1b image = createRamp(std::vector<bool>(8, true));
+    const std::array<float, 3> a{ { 0.f, 0.f, 1.f } }, b{ { 1.f, 0.f, 1.f } }, c{ { 2.f, 0.f, 1.f } };
+
+    // Each face has its own reference, the face follows small moves:
+    {
+        CaptureDedupe dedupe(1, 0.1f);
+        CHECK(!dedupe.isDuplicate(a, CaptureDedupe::kFrame, image));
+        CHECK(!dedupe.isDuplicate(b, CaptureDedupe::kFrame, image));
+        CHECK(dedupe.isDuplicate({ { 0.05f, 0.f, 1.f } }, CaptureDedupe::kFrame, image));
+        CHECK(dedupe.isDuplicate({ { 0.1f, 0.f, 1.f } }, CaptureDedupe::kFrame, image)); // followed from 0.05
+    }
+
+    // The least recently used face is replaced when the capacity is reached:
+    {
+        CaptureDedupe dedupe(1, 0.1f, 2);
+        CHECK(!dedupe.isDuplicate(a, CaptureDedupe::kFrame, image));
+        CHECK(!dedupe.isDuplicate(b, CaptureDedupe::kFrame, image));
+        CHECK(dedupe.isDuplicate(a, CaptureDedupe::kFrame, image)); // a is newer than b now
+        CHECK(!dedupe.isDuplicate(c, CaptureDedupe::kFrame, image)); // replaces b
+        CHECK(dedupe.isDuplicate(a, CaptureDedupe::kFrame, image));
+        CHECK(!dedupe.isDuplicate(b, CaptureDedupe::kFrame, image)); // forgotten
+    }
+
+    return failures;
+}
+
+// }
+
+// MotionGate: {
+
+static MotionGate::Settings getMotionSettings()
+{
+    MotionGate::Settings settings;
+    settings.maxVelocity = 0.1f;     // m/s
+    settings.maxAcceleration = 1.0f; // m/s^2
+    settings.frames = 3;
+    settings.radius = 0.1f;
+    return settings;
+}
+
+static int testMotionStill()
+{
+    int failures = 0;
+
+    // Still once K frames are under the limits, and the first measurement
+    // needs 3 samples (acceleration), so that is frame 3 + K - 1 = 5:
+    MotionGate gate(getMotionSettings());
+    const MotionGate::Position face{ { 0.f, 0.f, 1.f } };
+    for (int i = 0; i < 4; i++)
+    {
+        gate.update({ face }, i * 0.1);
+        CHECK(!gate.isStill(face));
+    }
+    gate.update({ face }, 0.4);
+    CHECK(gate.isStill(face));
+
+    // A fast step resets the count, the next frame still sees it as an
+    // acceleration, then K more still frames are needed:
+    const MotionGate::Position moved{ { 0.05f, 0.f, 1.f } }; // 0.5 m/s
+    for (int i = 0; i < 4; i++)
+    {
+        gate.update({ moved }, 0.5 + i * 0.1);
+        CHECK(!gate.isStill(moved));
+    }
+    gate.update({ moved }, 0.9);
+    CHECK(gate.isStill(moved));
+
+    // Unlimited settings (0) only need the K frames:
+    MotionGate::Settings unlimited;
+    unlimited.frames = 1;
+    MotionGate fast(unlimited);
+    for (int i = 0; i < 3; i++)
+    {
+        fast.update({ { { i * 0.05f, 0.f, 1.f } } }, i * 0.1);
+    }
+    CHECK(fast.isStill({ { 0.1f, 0.f, 1.f } }));
+
+    return failures;
+}
+
+static int testMotionTracks()
+{
+    int failures = 0;
+
+    // Two faces, listed in alternating order: one still, one moving at 0.5 m/s:
+    MotionGate gate(getMotionSettings());
+    MotionGate::Position still{ { 0.f, 0.f, 1.f } }, moving{ { 0.5f, 0.f, 1.f } };
+    for (int i = 0; i < 8; i++)
+    {
+        moving[0] = 0.5f + i * 0.05f;
+        if (i % 2)
+        {
+            gate.update({ still, moving }, i * 0.1);
+        }
+        else
+        {
+            gate.update({ moving, still }, i * 0.1);
+        }
+    }
+    CHECK(gate.isStill(still));
+    CHECK(!gate.isStill(moving));
+
+    // A face that is missing for a frame starts a new track:
+    gate.update({ moving }, 0.8);
+    gate.update({ still, moving }, 0.9);
+    CHECK(!gate.isStill(still));
+
+    // A jump beyond the association radius is a new face:
+    MotionGate jump(getMotionSettings());
+    for (int i = 0; i < 5; i++)
+    {
+        jump.update({ still }, i * 0.1);
+    }
+    CHECK(jump.isStill(still));
+    const MotionGate::Position far{ { 0.5f, 0.f, 1.f } };
+    jump.update({ far }, 0.5);
+    CHECK(!jump.isStill(far));
+
+    return failures;
+}
+
+static int testMotionTimestamps()
+{
+    int failures = 0;
+
+    // Repeated timestamps carry no new information (and no zero time step):
+    MotionGate gate(getMotionSettings());
+    const MotionGate::Position face{ { 0.f, 0.f, 1.f } };
+    for (int i = 0; i < 4; i++)
+    {
+        gate.update({ face }, i * 0.1);
+        gate.update({ face }, i * 0.1);
+    }
+    CHECK(!gate.isStill(face)); // 4 samples, not 8
+
+    // Even if the position changes, the track is kept:
+    gate.update({ { { 0.01f, 0.f, 1.f } } }, 0.3);
+    gate.update({ face }, 0.4);
+    CHECK(gate.isStill(face));
+
+    // Time going backwards is ignored too:
+    gate.update({ face }, 0.2);
+    CHECK(gate.isStill(face));
+
+    return failures;
+}
+
+// }
+
+int gauze_main(int argc, char** argv)
+{
+    const std::vector<std::pair<const char*, std::function<int()>>> tests = {
+        { "CaptureDedupe.hash", testDedupeHash },
+        { "CaptureDedupe.threshold", testDedupeThreshold },
+        { "CaptureDedupe.faces", testDedupeFaces },
+        { "MotionGate.still", testMotionStill },
+        { "MotionGate.tracks", testMotionTracks },
+        { "MotionGate.timestamps", testMotionTimestamps },
+    };
+
+    int failed = 0;
+    for (const auto& test : tests)
+    {
+        const int failures = test.second();
+        std::cout << (failures ? "FAILED " : "passed ") << test.first << std::endl;
+        failed += (failures > 0);
+    }
+
+    return failed ? 1 : 0;
+}